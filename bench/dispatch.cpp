@@ -0,0 +1,234 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Throughput of the descriptor-table dispatch against the branch ladder it replaced, when
+// skipping over an int-heavy and a string-heavy corpus.
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+
+#include "msgscan/format.hpp"
+#include "msgscan/visitor.hpp"
+
+
+namespace
+{
+
+using msgscan::Header;
+using msgscan::loadbe16;
+using msgscan::loadbe32;
+
+// The if/else ladder and switch that read_header used before the descriptor table.
+Header ladder_read_header(char const* p)
+{
+    auto const byte = static_cast<unsigned char>(*p);
+
+    if (byte <= 0x7fu)
+    {
+        return {1, 0, 0};
+    }
+    else if (byte <= 0x8fu)
+    {
+        return {1, 0, (byte - 0x80u) * 2u};
+    }
+    else if (byte <= 0x9fu)
+    {
+        return {1, 0, byte - 0x90u};
+    }
+    else if (byte <= 0xbfu)
+    {
+        return {1, byte - 0xa0u, 0};
+    }
+    else if (byte <= 0xdfu)
+    {
+        switch (byte)
+        {
+        case 0xc0u: case 0xc1u: case 0xc2u: case 0xc3u: return {1, 0, 0};
+        case 0xc4u: return {2, *reinterpret_cast<std::uint8_t const*>(p + 1), 0};
+        case 0xc5u: return {3, loadbe16(p + 1), 0};
+        case 0xc6u: return {5, loadbe32(p + 1), 0};
+        case 0xc7u: return {3, *reinterpret_cast<std::uint8_t const*>(p + 1), 0};
+        case 0xc8u: return {4, loadbe16(p + 1), 0};
+        case 0xc9u: return {6, loadbe32(p + 1), 0};
+        case 0xcau: return {1, 4, 0};
+        case 0xcbu: return {1, 8, 0};
+        case 0xccu: return {1, 1, 0};
+        case 0xcdu: return {1, 2, 0};
+        case 0xceu: return {1, 4, 0};
+        case 0xcfu: return {1, 8, 0};
+        case 0xd0u: return {1, 1, 0};
+        case 0xd1u: return {1, 2, 0};
+        case 0xd2u: return {1, 4, 0};
+        case 0xd3u: return {1, 8, 0};
+        case 0xd4u: return {2, 1, 0};
+        case 0xd5u: return {2, 2, 0};
+        case 0xd6u: return {2, 4, 0};
+        case 0xd7u: return {2, 8, 0};
+        case 0xd8u: return {2, 16, 0};
+        case 0xd9u: return {2, *reinterpret_cast<std::uint8_t const*>(p + 1), 0};
+        case 0xdau: return {3, loadbe16(p + 1), 0};
+        case 0xdbu: return {5, loadbe32(p + 1), 0};
+        case 0xdcu: return {3, 0, loadbe16(p + 1)};
+        case 0xddu: return {5, 0, loadbe32(p + 1)};
+        case 0xdeu: return {3, 0, loadbe16(p + 1) * std::uint64_t{2}};
+        default:    return {5, 0, loadbe32(p + 1) * std::uint64_t{2}};
+        }
+    }
+    else /*if (byte <= 0xffu)*/
+    {
+        return {1, 0, 0};
+    }
+}
+
+std::uint64_t ladder_skip(char const* p, char const* const end)
+{
+    std::uint64_t objects = 0;
+    for (std::uint64_t n = 0; p < end; ++objects)
+    {
+        auto const h = ladder_read_header(p);
+        p += h.size + h.payload;
+        n += h.count;
+    }
+    return objects;
+}
+
+std::uint64_t table_skip(char const* p, char const* const end)
+{
+    std::uint64_t objects = 0;
+    for (std::uint64_t n = 0; p < end; ++objects)
+    {
+        auto const h = msgscan::read_header(p);
+        p += h.size + h.payload;
+        n += h.count;
+    }
+    return objects;
+}
+
+// The bounds-checked skip the decoder uses, over every top-level object.
+std::uint64_t checked_skip(char const* p, char const* const end)
+{
+    std::uint64_t objects = 0;
+    while (p < end)
+    {
+        objects += !msgscan::skip(p, end, 1);
+    }
+    return objects;
+}
+
+struct CountingVisitor final : msgscan::BasicVisitor
+{
+    void on_uint(msgscan::Token, std::uint64_t v) { sum += v; }
+    void on_int(msgscan::Token, std::int64_t v) { sum += static_cast<std::uint64_t>(v); }
+    void on_str(msgscan::Token, char const*, std::uint32_t length) { sum += length; }
+
+    std::uint64_t sum = 0;
+};
+
+
+void put_be(std::string& out, std::uint64_t value, int bytes)
+{
+    while (bytes--)
+    {
+        out.push_back(static_cast<char>(value >> (bytes * 8)));
+    }
+}
+
+// One array 32 of ints in every width the format has.
+std::string int_corpus(std::size_t count)
+{
+    std::mt19937_64 random{42};
+    std::string out;
+    out.push_back('\xdd');
+    put_be(out, count, 4);
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        auto const v = random();
+        switch (v % 6)
+        {
+        case 0: out.push_back(static_cast<char>(v & 0x7fu)); break;
+        case 1: out.push_back(static_cast<char>(0xe0u | (v & 0x1fu))); break;
+        case 2: out.push_back('\xcc'); put_be(out, v, 1); break;
+        case 3: out.push_back('\xd1'); put_be(out, v, 2); break;
+        case 4: out.push_back('\xce'); put_be(out, v, 4); break;
+        case 5: out.push_back('\xd3'); put_be(out, v, 8); break;
+        }
+    }
+    return out;
+}
+
+// A sequence of fixmaps of short keys and str values of assorted lengths.
+std::string str_corpus(std::size_t count)
+{
+    std::mt19937_64 random{42};
+    std::string out;
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        out.push_back('\x84');
+        for (int k = 0; k != 4; ++k)
+        {
+            out.push_back(static_cast<char>(0xa4u));
+            out.append("key").push_back(static_cast<char>('0' + k));
+
+            auto const len = random() % 256;
+            if (len < 32)
+            {
+                out.push_back(static_cast<char>(0xa0u | len));
+            }
+            else
+            {
+                out.push_back('\xd9');
+                put_be(out, len, 1);
+            }
+            out.append(len, 'v');
+        }
+    }
+    return out;
+}
+
+
+template <class F>
+void measure(char const* name, std::string const& corpus, F&& f)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto best = clock::duration::max();
+    std::uint64_t result = 0;
+    for (int i = 0; i != 5; ++i)
+    {
+        auto const start = clock::now();
+        result += f(corpus.data(), corpus.data() + corpus.size());
+        best = std::min(best, clock::now() - start);
+    }
+
+    auto const seconds = std::chrono::duration<double>(best).count();
+    std::printf("  %-8s %9.1f MiB/s  (%llu)\n", name, static_cast<double>(corpus.size()) / seconds / (1 << 20), static_cast<unsigned long long>(result));
+}
+
+void run(char const* title, std::string const& corpus)
+{
+    std::printf("%s, %.1f MiB\n", title, static_cast<double>(corpus.size()) / (1 << 20));
+    measure("ladder", corpus, ladder_skip);
+    measure("table", corpus, table_skip);
+    measure("checked", corpus, checked_skip);
+    measure("scan", corpus, [](char const* begin, char const* end)
+    {
+        CountingVisitor visitor;
+        msgscan::scan(begin, end, visitor);
+        return visitor.sum;
+    });
+}
+
+} // namespace
+
+
+int main()
+{
+    run("int-heavy", int_corpus(std::size_t{1} << 25));
+    run("string-heavy", str_corpus(std::size_t{1} << 19));
+}
@@ -0,0 +1,176 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Scaling of the parallel record indexer against the single-threaded one.
+//
+//   bench_records [SIZE_MIB]   on generated log-like records (default 1024 MiB)
+//   bench_records FILE         on FILE, mapped (POSIX only)
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BENCH_HAS_MMAP 1
+#endif
+
+#include "msgscan/records.hpp"
+
+
+namespace
+{
+
+void put_be(std::string& out, std::uint64_t value, int bytes)
+{
+    while (bytes--)
+    {
+        out.push_back(static_cast<char>(value >> (bytes * 8)));
+    }
+}
+
+void put_str(std::string& out, char const* s, std::size_t length)
+{
+    if (length < 32)
+    {
+        out.push_back(static_cast<char>(0xa0u | length));
+    }
+    else
+    {
+        out.push_back('\xd9');
+        put_be(out, length, 1);
+    }
+    out.append(s, length);
+}
+
+// Records like {"ts": uint64, "level": str, "msg": str, "values": [float64...]}.
+std::string log_corpus(std::size_t bytes)
+{
+    static char const text[] = "the quick brown fox jumps over the lazy dog, again and again and again.";
+    static char const* const levels[] = {"debug", "info", "warn", "error"};
+
+    std::mt19937_64 random{42};
+    std::string out;
+    out.reserve(bytes + 512);
+    while (out.size() < bytes)
+    {
+        out.push_back('\x84');
+        put_str(out, "ts", 2);
+        out.push_back('\xcf');
+        put_be(out, random(), 8);
+        put_str(out, "level", 5);
+        auto const level = levels[random() % 4];
+        put_str(out, level, std::char_traits<char>::length(level));
+        put_str(out, "msg", 3);
+        put_str(out, text, random() % (sizeof(text) - 1));
+        put_str(out, "values", 6);
+        auto const n = random() % 8;
+        out.push_back(static_cast<char>(0x90u | n));
+        for (std::uint64_t i = 0; i != n; ++i)
+        {
+            out.push_back('\xcb');
+            put_be(out, random(), 8);
+        }
+    }
+    return out;
+}
+
+template <class F>
+double measure(F&& f)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto best = clock::duration::max();
+    for (int i = 0; i != 3; ++i)
+    {
+        auto const start = clock::now();
+        f();
+        best = std::min(best, clock::now() - start);
+    }
+    return std::chrono::duration<double>(best).count();
+}
+
+void run(char const* begin, char const* end)
+{
+    auto const size = static_cast<double>(end - begin);
+    auto const none = [](std::ptrdiff_t) { return true; };
+
+    std::vector<std::uint64_t> records;
+    auto truncated = false;
+    auto const single = measure([&]
+    {
+        records.clear();
+        msgscan::find_records(begin, end, records, truncated, none);
+    });
+    auto const count = records.size();
+
+    std::printf("%.1f MiB, %zu records\n", size / (1 << 20), count);
+    std::printf("  %-10s %8.1f MiB/s\n", "single", size / single / (1 << 20));
+
+    auto const cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned workers = 1; ; workers = std::min(workers * 2, cores))
+    {
+        auto const seconds = measure([&]
+        {
+            records.clear();
+            msgscan::find_records(begin, end, records, truncated, workers, none);
+        });
+        std::printf("  %-3u workers %7.1f MiB/s  x%.2f%s\n", workers, size / seconds / (1 << 20), single / seconds, records.size() == count ? "" : "  MISMATCH");
+        if (workers == cores) { break; }
+    }
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+    auto const arg = argc > 1 ? argv[1] : "1024";
+
+    char* last = nullptr;
+    auto const mib = std::strtoull(arg, &last, 10);
+    if (*last == '\0')
+    {
+        auto const corpus = log_corpus(static_cast<std::size_t>(mib) << 20);
+        run(corpus.data(), corpus.data() + corpus.size());
+        return 0;
+    }
+
+#ifdef BENCH_HAS_MMAP
+    auto const fd = ::open(arg, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        std::fprintf(stderr, "cannot open %s\n", arg);
+        return 1;
+    }
+
+    auto const size = static_cast<std::size_t>(st.st_size);
+    auto const data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        std::fprintf(stderr, "cannot map %s\n", arg);
+        return 1;
+    }
+
+    auto const begin = static_cast<char const*>(data);
+    run(begin, begin + size);
+    ::munmap(data, size);
+    ::close(fd);
+    return 0;
+#else
+    std::fprintf(stderr, "mapping files is not supported on this platform\n");
+    return 1;
+#endif
+}
@@ -0,0 +1,159 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Throughput of the str kernels over every str of a corpus, against converting each of them to
+// a QString up front as loading once did: UTF-8 validation and a search for text that does not
+// occur, by the scalar, SSE2 and AVX2 versions.
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+
+#include <QString>
+
+#include "msgscan/format.hpp"
+#include "msgscan/visitor.hpp"
+#include "msgscan/text.hpp"
+
+
+namespace
+{
+
+// Calls `f(data, length)` for every str, adding up what it returns.
+template <class F>
+struct StrVisitor final : msgscan::BasicVisitor
+{
+    explicit StrVisitor(F& f) : f(f) { }
+
+    void on_str(msgscan::Token, char const* data, std::uint32_t length) { sum += f(data, length); }
+
+    F& f;
+    std::uint64_t sum = 0;
+};
+
+void put_be(std::string& out, std::uint64_t value, int bytes)
+{
+    while (bytes--)
+    {
+        out.push_back(static_cast<char>(value >> (bytes * 8)));
+    }
+}
+
+void put_str(std::string& out, std::string const& text)
+{
+    if (text.size() < 32)
+    {
+        out.push_back(static_cast<char>(0xa0u | text.size()));
+    }
+    else if (text.size() < 256)
+    {
+        out.push_back('\xd9');
+        put_be(out, text.size(), 1);
+    }
+    else
+    {
+        out.push_back('\xda');
+        put_be(out, text.size(), 2);
+    }
+    out += text;
+}
+
+// Log-like records: fixmaps of short keys and messages of assorted lengths, drawn from
+// `alphabet` (UTF-8 sequences).
+std::string str_corpus(std::size_t count, std::vector<std::string> const& alphabet)
+{
+    std::mt19937_64 random{42};
+    std::string out;
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        out.push_back('\x83');
+        for (char const* key : {"time", "host", "message"})
+        {
+            put_str(out, key);
+
+            std::string text;
+            for (auto n = random() % 400; text.size() < n; )
+            {
+                text += alphabet[random() % alphabet.size()];
+            }
+            put_str(out, text);
+        }
+    }
+    return out;
+}
+
+
+template <class F>
+void measure(char const* name, std::string const& corpus, F f)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto best = clock::duration::max();
+    std::uint64_t result = 0;
+    for (int i = 0; i != 5; ++i)
+    {
+        auto const start = clock::now();
+        StrVisitor<F> visitor{f};
+        msgscan::scan(corpus.data(), corpus.data() + corpus.size(), visitor);
+        result += visitor.sum;
+        best = std::min(best, clock::now() - start);
+    }
+
+    auto const seconds = std::chrono::duration<double>(best).count();
+    std::printf("  %-14s %9.1f MiB/s  (%llu)\n", name, static_cast<double>(corpus.size()) / seconds / (1 << 20), static_cast<unsigned long long>(result));
+}
+
+void run(char const* title, std::string const& corpus)
+{
+    using namespace msgscan::detail;
+
+    static char const needle[] = "connection reset by peer";
+    auto const n = sizeof(needle) - 1;
+
+    std::printf("%s, %.1f MiB\n", title, static_cast<double>(corpus.size()) / (1 << 20));
+    measure("scan only", corpus, [](char const*, std::uint32_t length) { return length; });
+    measure("QString", corpus, [](char const* data, std::uint32_t length) { return QString::fromUtf8(data, static_cast<int>(length)).size(); });
+
+    measure("utf8 scalar", corpus, [](char const* data, std::uint32_t length) { return valid_utf8_scalar(data, length); });
+#if MSGSCAN_SSE2
+    measure("utf8 sse2", corpus, [](char const* data, std::uint32_t length) { return valid_utf8_sse2(data, length); });
+#endif
+#if MSGSCAN_AVX2
+    if (has_avx2())
+    {
+        measure("utf8 avx2", corpus, [](char const* data, std::uint32_t length) { return length < 32 ? valid_utf8_scalar(data, length) : valid_utf8_avx2(data, length); });
+    }
+#endif
+
+    measure("find scalar", corpus, [&](char const* data, std::uint32_t length) { return length >= n && find_scalar(data, length, needle, n); });
+#if MSGSCAN_SSE2
+    measure("find sse2", corpus, [&](char const* data, std::uint32_t length) { return length >= n && find_sse2(data, length, needle, n); });
+#endif
+#if MSGSCAN_AVX2
+    if (has_avx2())
+    {
+        measure("find avx2", corpus, [&](char const* data, std::uint32_t length) { return length >= n && find_avx2(data, length, needle, n); });
+    }
+#endif
+}
+
+} // namespace
+
+
+int main()
+{
+    std::vector<std::string> ascii;
+    for (char c = ' '; c != '\x7f'; ++c)
+    {
+        ascii.push_back(std::string(1, c));
+    }
+    run("ASCII", str_corpus(std::size_t{1} << 17, ascii));
+
+    // Mostly Japanese, with some ASCII and the odd four-byte sequence.
+    run("mixed", str_corpus(std::size_t{1} << 17, {"\xe3\x81\x82", "\xe6\x97\xa5", "\xe6\x9c\xac", "\xe8\xaa\x9e", "a", " ", "1", "\xf0\x9f\x98\x80"}));
+}
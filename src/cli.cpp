@@ -0,0 +1,542 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include <QString>
+
+#include "msgscan/format.hpp"
+#include "msgscan/visitor.hpp"
+#include "msgscan/push.hpp"
+#include "msgscan/text.hpp"
+#include "msgscan/query.hpp"
+#include "msgscan/records.hpp"
+#include "msgscan/schema.hpp"
+
+#include "mapped_file.hpp"
+#include "cli.hpp"
+
+
+namespace
+{
+
+using msgscan::Token;
+
+enum class Command
+{
+    dump,
+    stats,
+    validate,
+    query,
+    schema,
+    bytes,
+};
+
+
+// Writes `length` bytes of a str between double quotes, escaping quotes, backslashes and
+// control characters; other bytes, UTF-8 included, are written as they are.
+void write_quoted(std::FILE* out, char const* data, std::uint32_t length)
+{
+    std::fputc('"', out);
+
+    auto run = data;
+    for (auto p = data, end = data + length; p != end; ++p)
+    {
+        auto const c = static_cast<unsigned char>(*p);
+        if (c >= 0x20u && c != '"' && c != '\\' && c != 0x7fu) { continue; }
+
+        std::fwrite(run, 1, static_cast<std::size_t>(p - run), out);
+        switch (c)
+        {
+        case '"': std::fputs("\\\"", out); break;
+        case '\\': std::fputs("\\\\", out); break;
+        case '\n': std::fputs("\\n", out); break;
+        case '\r': std::fputs("\\r", out); break;
+        case '\t': std::fputs("\\t", out); break;
+        default: std::fprintf(out, "\\x%02x", c); break;
+        }
+        run = p + 1;
+    }
+    std::fwrite(run, 1, static_cast<std::size_t>(data + length - run), out);
+
+    std::fputc('"', out);
+}
+
+
+// One line per object: its offset in hex, then its type and value, indented by depth.
+// Only the current depth is kept, so memory use does not grow with the input.
+struct DumpVisitor final : msgscan::BasicVisitor
+{
+    explicit DumpVisitor(std::FILE* out) : out{out} { }
+
+    void on_nil(Token t) { line(t); end_line(); }
+    void on_never_used(Token t) { line(t); end_line(); }
+    void on_bool(Token t, bool) { line(t); end_line(); }
+    void on_uint(Token t, std::uint64_t value) { line(t); std::fprintf(out, ": %llu", static_cast<unsigned long long>(value)); end_line(); }
+    void on_int(Token t, std::int64_t value) { line(t); std::fprintf(out, ": %lld", static_cast<long long>(value)); end_line(); }
+    void on_float(Token t, double value) { line(t); std::fprintf(out, ": %.17g", value); end_line(); }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        line(t);
+        std::fputs(": ", out);
+        write_quoted(out, data, length);
+        end_line();
+    }
+
+    void on_bin(Token t, char const*, std::uint32_t length)
+    {
+        line(t);
+        std::fprintf(out, ": length %u", length);
+        end_line();
+    }
+
+    void on_ext(Token t, std::int8_t type, char const*, std::uint32_t length)
+    {
+        line(t);
+        std::fprintf(out, ": type %d length %u", type, length);
+        end_line();
+    }
+
+    bool begin_array(Token t, std::uint32_t count) { return begin(t, count); }
+    bool begin_map(Token t, std::uint32_t count) { return begin(t, count); }
+    void end_array(Token) { --depth; }
+    void end_map(Token) { --depth; }
+
+    void on_truncated(Token t)
+    {
+        line(t);
+        std::fputs(": truncated", out);
+        end_line();
+        truncated = true;
+    }
+
+    bool truncated = false;
+
+    // Added to the offsets printed, for a dump of part of the input.
+    std::uint64_t base = 0;
+
+private:
+    void line(Token t)
+    {
+        std::fprintf(out, "%08llx  %*s%s", static_cast<unsigned long long>(base + t.offset), static_cast<int>(depth * 2), "", msgscan::type_name(t.type));
+    }
+
+    void end_line() { std::fputc('\n', out); }
+
+    bool begin(Token t, std::uint32_t count)
+    {
+        line(t);
+        std::fprintf(out, ": count %u", count);
+        end_line();
+        ++depth;
+        return true;
+    }
+
+    std::FILE* const out;
+    std::uint32_t depth = 0;
+};
+
+
+// Counts objects and their encoded bytes by type byte; names that cover several bytes
+// (fixint, fixstr, ...) are merged when printing.  The bytes of an array or map are those of
+// its header, its elements being counted on their own.
+struct StatsVisitor final : msgscan::BasicVisitor
+{
+    void on_nil(Token t) { count(t, 0); }
+    void on_never_used(Token t) { count(t, 0); }
+    void on_bool(Token t, bool) { count(t, 0); }
+    void on_uint(Token t, std::uint64_t) { count(t, msgscan::descriptor(t.type).fixed); }
+    void on_int(Token t, std::int64_t) { count(t, msgscan::descriptor(t.type).fixed); }
+    void on_float(Token t, double) { count(t, msgscan::descriptor(t.type).fixed); }
+    void on_str(Token t, char const*, std::uint32_t length) { count(t, length); }
+    void on_bin(Token t, char const*, std::uint32_t length) { count(t, length); }
+    void on_ext(Token t, std::int8_t, char const*, std::uint32_t length) { count(t, length); }
+    bool begin_array(Token t, std::uint32_t) { count(t, 0); return ++depth, true; }
+    bool begin_map(Token t, std::uint32_t) { count(t, 0); return ++depth, true; }
+    void end_array(Token) { --depth; }
+    void end_map(Token) { --depth; }
+    void on_truncated(Token t) { truncated = true; truncation = t.offset; }
+
+    void print(std::FILE* out) const
+    {
+        std::uint64_t total = 0;
+        std::uint64_t total_bytes = 0;
+        for (unsigned byte = 0; byte != 256; ++byte)
+        {
+            auto const name = msgscan::type_name(byte);
+
+            // Print each name once, at the first byte that has it.
+            if (byte && std::strcmp(name, msgscan::type_name(byte - 1)) == 0) { continue; }
+
+            std::uint64_t n = 0;
+            std::uint64_t size = 0;
+            for (auto b = byte; b != 256 && std::strcmp(msgscan::type_name(b), name) == 0; ++b)
+            {
+                n += counts[b];
+                size += bytes[b];
+            }
+            if (n) { std::fprintf(out, "%-16s %12llu %14llu bytes\n", name, static_cast<unsigned long long>(n), static_cast<unsigned long long>(size)); }
+            total += n;
+            total_bytes += size;
+        }
+
+        std::fprintf(out, "%-16s %12llu %14llu bytes\n", "objects", static_cast<unsigned long long>(total), static_cast<unsigned long long>(total_bytes));
+        std::fprintf(out, "%-16s %12llu\n", "top-level", static_cast<unsigned long long>(roots));
+        std::fprintf(out, "%-16s %12u\n", "max depth", max_depth);
+        if (truncated) { std::fprintf(out, "%-16s %12llx\n", "truncated at", static_cast<unsigned long long>(truncation)); }
+    }
+
+    bool truncated = false;
+    std::uint64_t truncation = 0;
+
+private:
+    void count(Token t, std::uint64_t payload)
+    {
+        ++counts[t.type];
+        bytes[t.type] += msgscan::descriptor(t.type).size + payload;
+        roots += depth == 0;
+        max_depth = depth + 1 > max_depth ? depth + 1 : max_depth;
+    }
+
+    std::uint64_t counts[256] = {};
+    std::uint64_t bytes[256] = {};
+    std::uint64_t roots = 0;
+    std::uint32_t depth = 0;
+    std::uint32_t max_depth = 0;
+};
+
+
+// Finds the first object that makes the input malformed: a never-used type byte, one cut
+// short by the end of the input, or a str that is not UTF-8.
+struct ValidateVisitor final : msgscan::BasicVisitor
+{
+    void on_never_used(Token t) { fail(t, "invalid type byte"); }
+    void on_truncated(Token t) { fail(t, "truncated"); }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        if (!msgscan::valid_utf8(data, length)) { fail(t, "invalid UTF-8"); }
+    }
+
+    void fail(Token t, char const* what)
+    {
+        if (error) { return; }
+        error = what;
+        offset = t.offset;
+        type = t.type;
+    }
+
+    char const* error = nullptr;
+    std::uint64_t offset = 0;
+    std::uint8_t type = 0;
+};
+
+
+// One line per path found in the records: how often it occurs, the kinds of objects there and
+// how many of each, and the range of their lengths and of their numeric values.
+void print_schema(std::FILE* out, msgscan::Schema const& schema)
+{
+    auto const report = schema.report();
+
+    std::size_t width = 4;
+    for (auto const& r : report)
+    {
+        width = std::max(width, r.first.size());
+    }
+
+    std::fprintf(out, "%-*s %12s  %s\n", static_cast<int>(width), "path", "count", "kinds");
+    for (auto const& r : report)
+    {
+        auto const& shape = r.second;
+        std::fprintf(out, "%-*s %12llu ", static_cast<int>(width), r.first.c_str(), static_cast<unsigned long long>(shape.count));
+
+        auto separator = " ";
+        for (std::size_t k = 0; k != msgscan::Shape::kind_count; ++k)
+        {
+            if (!shape.kinds[k]) { continue; }
+            std::fprintf(out, "%s%s %llu", separator, msgscan::Shape::kind_name(static_cast<msgscan::Shape::Kind>(k)), static_cast<unsigned long long>(shape.kinds[k]));
+            separator = ", ";
+        }
+        if (shape.has_length())
+        {
+            std::fprintf(out, "; length %llu..%llu", static_cast<unsigned long long>(shape.min_length), static_cast<unsigned long long>(shape.max_length));
+        }
+        if (shape.has_value())
+        {
+            std::fprintf(out, "; value %.17g..%.17g", shape.min_value, shape.max_value);
+        }
+        std::fputc('\n', out);
+    }
+}
+
+
+// Writes `field` as a CSV field, quoted if it has to be.
+void write_csv_field(std::FILE* out, std::string const& field)
+{
+    if (field.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        std::fputs(field.c_str(), out);
+        return;
+    }
+
+    std::fputc('"', out);
+    for (auto c : field)
+    {
+        if (c == '"') { std::fputc('"', out); }
+        std::fputc(c, out);
+    }
+    std::fputc('"', out);
+}
+
+// Where the bytes of the records go, as CSV: one row per path and kind of object found there,
+// plus one per path of maps for their keys, with the number of objects, their encoded bytes,
+// and how many of those are headers and how many payload.  Rows are sorted by bytes, most
+// first.
+void print_bytes(std::FILE* out, msgscan::Schema const& schema)
+{
+    struct Row
+    {
+        std::string const* path;
+        char const* kind;
+        std::uint64_t count;
+        std::uint64_t bytes;
+        std::uint64_t header_bytes;
+    };
+
+    auto const report = schema.report();
+    std::vector<Row> rows;
+    for (auto const& r : report)
+    {
+        auto const& shape = r.second;
+        for (std::size_t k = 0; k != msgscan::Shape::kind_count; ++k)
+        {
+            if (!shape.kinds[k]) { continue; }
+            rows.push_back(Row{&r.first, msgscan::Shape::kind_name(static_cast<msgscan::Shape::Kind>(k)), shape.kinds[k], shape.bytes[k], shape.header_bytes[k]});
+        }
+        if (shape.keys) { rows.push_back(Row{&r.first, "key", shape.keys, shape.key_bytes, shape.key_header_bytes}); }
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](Row const& a, Row const& b) { return a.bytes > b.bytes; });
+
+    std::fputs("path,kind,count,bytes,header_bytes,payload_bytes\n", out);
+    for (auto const& r : rows)
+    {
+        write_csv_field(out, *r.path);
+        std::fprintf(out, ",%s,%llu,%llu,%llu,%llu\n", r.kind, static_cast<unsigned long long>(r.count), static_cast<unsigned long long>(r.bytes), static_cast<unsigned long long>(r.header_bytes), static_cast<unsigned long long>(r.bytes - r.header_bytes));
+    }
+}
+
+
+// Reports every object in the file `name`, or on standard input if that is "-", to `visitor`,
+// and sets `size` to the number of bytes there were.  Standard input is parsed a chunk at a
+// time as it is read, so it may be of any length.  Returns false if the file cannot be opened.
+template <class Visitor>
+bool scan_input(char const* name, Visitor& visitor, std::uint64_t& size)
+{
+    if (std::strcmp(name, "-") != 0)
+    {
+        MappedFile const file{QString::fromLocal8Bit(name)};
+        if (!file.is_open()) { return false; }
+
+        msgscan::scan(file.begin(), file.end(), visitor);
+        size = static_cast<std::uint64_t>(file.size());
+        return true;
+    }
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+    std::vector<char> chunk(std::size_t{1} << 20);
+    msgscan::PushState state;
+    std::size_t n;
+    size = 0;
+    while ((n = std::fread(chunk.data(), 1, chunk.size(), stdin)) != 0)
+    {
+        msgscan::push(state, chunk.data(), chunk.data() + n, visitor);
+        size += n;
+    }
+    msgscan::finish(state, visitor);
+    return true;
+}
+
+template <class Visitor>
+bool scan_input(char const* name, Visitor& visitor)
+{
+    std::uint64_t size;
+    return scan_input(name, visitor, size);
+}
+
+int usage(char const* program)
+{
+    std::fprintf(stderr, "usage: %s [--dump | --stats | --validate | --schema | --bytes | --query QUERY] FILE\n", program);
+    return 2;
+}
+
+} // namespace
+
+
+int run_cli(int argc, char** argv)
+{
+    if (argc < 2) { return -1; }
+
+    Command command;
+    if (std::strcmp(argv[1], "--dump") == 0) { command = Command::dump; }
+    else if (std::strcmp(argv[1], "--stats") == 0) { command = Command::stats; }
+    else if (std::strcmp(argv[1], "--validate") == 0) { command = Command::validate; }
+    else if (std::strcmp(argv[1], "--schema") == 0) { command = Command::schema; }
+    else if (std::strcmp(argv[1], "--bytes") == 0) { command = Command::bytes; }
+    else if (std::strcmp(argv[1], "--query") == 0) { command = Command::query; }
+    else { return -1; }
+
+    if (argc != (command == Command::query ? 4 : 3)) { return usage(argv[0]); }
+    auto const name = argv[argc - 1];
+
+    auto const cannot_open = [&]
+    {
+        std::fprintf(stderr, "%s: cannot open %s\n", argv[0], name);
+        return 2;
+    };
+
+    // Output of a dump is many times the size of the input; write it in large blocks.
+    static char buffer[1 << 16];
+    std::setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+
+    switch (command)
+    {
+    case Command::dump:
+    {
+        DumpVisitor visitor{stdout};
+        if (!scan_input(name, visitor)) { return cannot_open(); }
+        std::fflush(stdout);
+        return visitor.truncated ? 1 : 0;
+    }
+
+    case Command::stats:
+    {
+        StatsVisitor visitor;
+        if (!scan_input(name, visitor)) { return cannot_open(); }
+        visitor.print(stdout);
+        std::fflush(stdout);
+        return visitor.truncated ? 1 : 0;
+    }
+
+    case Command::validate:
+    {
+        ValidateVisitor visitor;
+        if (!scan_input(name, visitor)) { return cannot_open(); }
+        if (visitor.error)
+        {
+            std::printf("%s: %s at offset %llx (%s)\n", name, visitor.error, static_cast<unsigned long long>(visitor.offset), msgscan::type_name(visitor.type));
+            std::fflush(stdout);
+            return 1;
+        }
+        std::printf("%s: ok\n", name);
+        std::fflush(stdout);
+        return 0;
+    }
+
+    case Command::schema:
+    case Command::bytes:
+    {
+        msgscan::Schema schema;
+        auto truncated = false;
+        std::uint64_t truncation = 0;
+        std::uint64_t size = 0;
+        auto const workers = std::thread::hardware_concurrency();
+        if (std::strcmp(name, "-") == 0 || workers <= 1)
+        {
+            msgscan::SchemaVisitor visitor{schema};
+            if (!scan_input(name, visitor, size)) { return cannot_open(); }
+            truncated = visitor.truncated;
+            truncation = visitor.truncation;
+        }
+        else
+        {
+            MappedFile const file{QString::fromLocal8Bit(name)};
+            if (!file.is_open()) { return cannot_open(); }
+            size = static_cast<std::uint64_t>(file.size());
+
+            // Records are found from headers alone, so that workers can take whole ones.
+            std::vector<std::uint64_t> records;
+            msgscan::find_records(file.begin(), file.end(), records, truncated, workers, [](std::ptrdiff_t) { return true; });
+            if (truncated)
+            {
+                // The object cut short, as a scan of the whole input would report it.
+                msgscan::Schema last;
+                msgscan::SchemaVisitor visitor{last};
+                msgscan::scan(file.begin() + records.back(), file.end(), visitor);
+                truncation = records.back() + visitor.truncation;
+            }
+            msgscan::infer_schema(file.begin(), file.end(), records.data(), records.size(), workers, schema, [](std::uint64_t) { return true; });
+        }
+        if (command == Command::schema) { print_schema(stdout, schema); }
+        else { print_bytes(stdout, schema); }
+        std::fflush(stdout);
+
+        // What there is of the last record is in the report, but the input is malformed.
+        if (truncated)
+        {
+            std::fprintf(stderr, "%s: truncated at offset %llx\n", name, static_cast<unsigned long long>(truncation));
+            if (command == Command::bytes)
+            {
+                // Objects cut short are not counted at any path, so the table falls short of the input.
+                std::uint64_t counted = 0;
+                for (auto const& r : schema.report()) { counted += r.second.total_bytes(); }
+                std::fprintf(stderr, "%s: %llu bytes are not counted\n", name, static_cast<unsigned long long>(size - counted));
+            }
+            return 1;
+        }
+        return 0;
+    }
+
+    case Command::query:
+    {
+        msgscan::PathQuery query;
+        if (auto const error = msgscan::parse(argv[2], query))
+        {
+            std::fprintf(stderr, "%s: %s in query %s\n", argv[0], error, argv[2]);
+            return 2;
+        }
+
+        // Matches are printed from the mapped file once their record is done with, so unlike
+        // the other commands this one needs a file rather than standard input.
+        if (std::strcmp(name, "-") == 0) { return usage(argv[0]); }
+
+        MappedFile const file{QString::fromLocal8Bit(name)};
+        if (!file.is_open()) { return cannot_open(); }
+
+        // Each match is dumped on its own, with offsets still counted from the start of the file.
+        DumpVisitor dump{stdout};
+        std::uint64_t matches = 0;
+        auto visitor = msgscan::make_query_visitor(query, 0, [&](std::uint64_t offset)
+        {
+            auto const start = file.begin() + offset;
+            auto p = start;
+            msgscan::skip(p, file.end(), 1);
+
+            dump.base = offset;
+            msgscan::scan(start, p, dump);
+            ++matches;
+        });
+        msgscan::scan(file.begin(), file.end(), visitor);
+
+        std::fflush(stdout);
+        return matches ? 0 : 1;
+    }
+    }
+    return 2;
+}
@@ -0,0 +1,29 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGVIEWER_CLI_HPP
+#define MSGVIEWER_CLI_HPP
+
+// Runs the headless command given on the command line, if any:
+//
+//   msgviewer --dump FILE      one line per object, indented by depth
+//   msgviewer --stats FILE     number and encoded bytes of objects of each type
+//   msgviewer --validate FILE  whether FILE is a well-formed sequence of objects, with
+//                              UTF-8 text in every str
+//   msgviewer --schema FILE    every path found in the records, with the kinds, lengths and
+//                              numeric ranges of the objects there
+//   msgviewer --bytes FILE     CSV of where the bytes go: encoded, header and payload bytes
+//                              of the objects of each kind, and of map keys, by path
+//   msgviewer --query QUERY FILE
+//                              a dump of each object selected by QUERY, a path query such
+//                              as '.events[*].latency_ms where .status == 500' (see
+//                              msgscan/query.hpp); exits with 1 if nothing matched
+//
+// FILE may be "-" for standard input, which is decoded as it is read, except with --query.
+// Results go to stdout, errors to stderr.  Returns the exit code, or -1 if the command line
+// names no command and the GUI should start instead.
+int run_cli(int argc, char** argv);
+
+#endif // MSGVIEWER_CLI_HPP
@@ -0,0 +1,123 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGVIEWER_FLAT_MAP_HPP
+#define MSGVIEWER_FLAT_MAP_HPP
+
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+
+// Hash map from integers (all but the largest) to values, kept in a single array
+// with linear probing.  Unlike std::unordered_map, which allocates a node per entry, it grows
+// by doubling, so n insertions make O(log n) allocations and clearing it frees one block.
+template <class Value>
+class FlatMap final
+{
+public:
+    Value const* find(std::size_t key) const noexcept
+    {
+        if (entries.empty()) { return nullptr; }
+        for (auto i = slot(key); entries[i].key != empty; i = next(i))
+        {
+            if (entries[i].key == key) { return &entries[i].value; }
+        }
+        return nullptr;
+    }
+
+    // Adds `key` unless it is there already.
+    void emplace(std::size_t key, Value value)
+    {
+        if ((count + 1) * 2 > entries.size()) { rehash(entries.empty() ? 64 : entries.size() * 2); }
+
+        auto i = slot(key);
+        for (; entries[i].key != empty; i = next(i))
+        {
+            if (entries[i].key == key) { return; }
+        }
+        entries[i] = Entry{key, std::move(value)};
+        ++count;
+    }
+
+    void erase(std::size_t key)
+    {
+        if (entries.empty()) { return; }
+
+        auto i = slot(key);
+        for (; entries[i].key != key; i = next(i))
+        {
+            if (entries[i].key == empty) { return; }
+        }
+
+        // Shift back the entries after the gap that would no longer be found past it.
+        for (auto j = next(i); entries[j].key != empty; j = next(j))
+        {
+            auto const home = slot(entries[j].key);
+            if (((j - home) & mask()) >= ((j - i) & mask()))
+            {
+                entries[i] = std::move(entries[j]);
+                i = j;
+            }
+        }
+        entries[i].key = empty;
+        --count;
+    }
+
+    std::size_t size() const noexcept { return count; }
+
+    // Calls f(key, value) for every entry, in no particular order.
+    template <class F>
+    void for_each(F f)
+    {
+        for (auto& e : entries)
+        {
+            if (e.key != empty) { f(e.key, e.value); }
+        }
+    }
+
+    void swap(FlatMap& other) noexcept
+    {
+        entries.swap(other.entries);
+        std::swap(count, other.count);
+    }
+
+private:
+    static constexpr std::size_t empty = ~std::size_t{};
+
+    struct Entry
+    {
+        std::size_t key;
+        Value value;
+    };
+
+    std::size_t mask() const noexcept { return entries.size() - 1; }
+    std::size_t next(std::size_t i) const noexcept { return (i + 1) & mask(); }
+
+    std::size_t slot(std::size_t key) const noexcept
+    {
+        // Fibonacci hashing, as consecutive keys are the common case.
+        return static_cast<std::size_t>(static_cast<unsigned long long>(key) * 0x9e3779b97f4a7c15ull >> 32) & mask();
+    }
+
+    void rehash(std::size_t size)
+    {
+        std::vector<Entry> old(size, Entry{empty, Value{}});
+        old.swap(entries);
+        for (auto& e : old)
+        {
+            if (e.key == empty) { continue; }
+
+            auto i = slot(e.key);
+            while (entries[i].key != empty) { i = next(i); }
+            entries[i] = std::move(e);
+        }
+    }
+
+    std::vector<Entry> entries; // Size a power of two, at most half full.
+    std::size_t count = 0;
+};
+
+#endif // MSGVIEWER_FLAT_MAP_HPP
@@ -0,0 +1,197 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+#include <QString>
+#include <QByteArray>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include "index_file.hpp"
+
+
+namespace
+{
+
+// The sidecar is the header below, then the record offsets, then the extents, all in the
+// writer's native layout so that they can be used straight from the mapping.  A reader with
+// a different byte order or layout sees a different `version` or `byte_order` and ignores
+// the file.
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t file_size;
+    std::int64_t file_mtime;       // In ms since the epoch.
+    unsigned char digest[16];      // MD5 of the first and last 64 KiB.
+    std::uint64_t truncation;
+    std::uint64_t record_count;
+    std::uint64_t extent_count;
+    std::uint32_t has_structure;
+    std::uint32_t reserved;
+};
+
+char const magic[8] = {'M', 'S', 'G', 'V', 'I', 'D', 'X', '\0'};
+
+// Bumped with any change to Header or msgscan::Extent.
+constexpr std::uint32_t version = 2;
+constexpr std::uint32_t byte_order = 0x01020304;
+
+constexpr qint64 digest_span = 64 << 10;
+
+// Indexes of other files are removed, oldest first, while they take more than this.
+constexpr qint64 cache_limit = qint64{1} << 30;
+
+// The layout `version` stands for.  Neither has padding in the middle.
+static_assert(sizeof(Header) == 80, "bump version");
+static_assert(offsetof(msgscan::Extent, offset) == 0 && offsetof(msgscan::Extent, end) == 8 && offsetof(msgscan::Extent, elements) == 16
+    && offsetof(msgscan::Extent, containers) == 24 && offsetof(msgscan::Extent, truncated) == 32 && sizeof(msgscan::Extent) == 40, "bump version");
+static_assert(sizeof(Header) % alignof(msgscan::Extent) == 0, "arrays must stay aligned");
+
+
+QString index_path(MappedFile const& file)
+{
+    auto const dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/index");
+    auto const name = QCryptographicHash::hash(QFileInfo{file.filename()}.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return dir + QStringLiteral("/") + QString::fromLatin1(name.constData()) + QStringLiteral(".idx");
+}
+
+// Header identifying the current contents of `file`, with no index yet.
+Header make_header(MappedFile const& file)
+{
+    Header h{};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.byte_order = byte_order;
+    h.file_size = static_cast<std::uint64_t>(file.size());
+    h.file_mtime = QFileInfo{file.filename()}.lastModified().toMSecsSinceEpoch();
+
+    // Only the head and tail are read, to keep reopening cheap; the size and modification
+    // time catch most other changes.
+    QCryptographicHash hash{QCryptographicHash::Md5};
+    auto const head = std::min(file.size(), digest_span);
+    auto const tail = std::min(file.size() - head, digest_span);
+    hash.addData(file.begin(), static_cast<int>(head));
+    hash.addData(file.end() - tail, static_cast<int>(tail));
+    auto const digest = hash.result();
+    std::memcpy(h.digest, digest.constData(), sizeof(h.digest));
+
+    return h;
+}
+
+// Extents as saved: field by field into zeroed memory, so that the padding after `truncated`
+// is written as zeros rather than whatever the extents were built over.
+bool write_extents(QSaveFile& out, ArrayView<msgscan::Extent> const& structure)
+{
+    using msgscan::Extent;
+    constexpr std::size_t chunk = 4096;
+
+    std::vector<char> buffer;
+    for (std::size_t first = 0; first < structure.size(); first += chunk)
+    {
+        auto const count = std::min(chunk, structure.size() - first);
+        buffer.assign(count * sizeof(Extent), 0);
+        for (std::size_t i = 0; i != count; ++i)
+        {
+            auto const& e = structure[first + i];
+            auto const p = buffer.data() + i * sizeof(Extent);
+            std::memcpy(p + offsetof(Extent, offset), &e.offset, sizeof(e.offset));
+            std::memcpy(p + offsetof(Extent, end), &e.end, sizeof(e.end));
+            std::memcpy(p + offsetof(Extent, elements), &e.elements, sizeof(e.elements));
+            std::memcpy(p + offsetof(Extent, containers), &e.containers, sizeof(e.containers));
+            std::memcpy(p + offsetof(Extent, truncated), &e.truncated, sizeof(e.truncated));
+        }
+        auto const size = static_cast<qint64>(buffer.size());
+        if (out.write(buffer.data(), size) != size) { return false; }
+    }
+    return true;
+}
+
+// Removes the least recently written indexes in `dir` but `kept` while they take more than
+// cache_limit.
+void prune(QDir const& dir, QString const& kept)
+{
+    auto entries = dir.entryInfoList(QStringList{QStringLiteral("*.idx")}, QDir::Files, QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    for (auto const& e : entries) { total += e.size(); }
+
+    for (auto const& e : entries)
+    {
+        if (total <= cache_limit) { break; }
+        if (e.absoluteFilePath() == QFileInfo{kept}.absoluteFilePath()) { continue; }
+        if (QFile::remove(e.absoluteFilePath())) { total -= e.size(); }
+    }
+}
+
+} // namespace
+
+
+std::unique_ptr<MappedFile const> open_index(MappedFile const& file, FileIndex& index)
+{
+    auto sidecar = std::make_unique<MappedFile const>(index_path(file));
+    if (!sidecar->is_open() || sidecar->size() < static_cast<qint64>(sizeof(Header))) { return nullptr; }
+
+    Header saved;
+    std::memcpy(&saved, sidecar->begin(), sizeof(saved));
+
+    auto const expected = make_header(file);
+    auto const same = std::memcmp(saved.magic, expected.magic, sizeof(magic)) == 0
+        && saved.version == expected.version
+        && saved.byte_order == expected.byte_order
+        && saved.file_size == expected.file_size
+        && saved.file_mtime == expected.file_mtime
+        && std::memcmp(saved.digest, expected.digest, sizeof(saved.digest)) == 0;
+    if (!same) { return nullptr; }
+
+    // Guard against a short or otherwise damaged file before pointing into it.
+    auto const records_size = saved.record_count * sizeof(std::uint64_t);
+    auto const extents_size = saved.extent_count * sizeof(msgscan::Extent);
+    auto const available = static_cast<std::uint64_t>(sidecar->size()) - sizeof(Header);
+    if (saved.record_count > available / sizeof(std::uint64_t) || saved.extent_count > available / sizeof(msgscan::Extent)) { return nullptr; }
+    if (records_size + extents_size != available) { return nullptr; }
+
+    auto const records = sidecar->begin() + sizeof(Header);
+    auto const extents = records + records_size;
+    index.records = {reinterpret_cast<std::uint64_t const*>(records), static_cast<std::size_t>(saved.record_count)};
+    index.structure = {reinterpret_cast<msgscan::Extent const*>(extents), static_cast<std::size_t>(saved.extent_count)};
+    index.truncation = saved.truncation;
+    index.has_structure = saved.has_structure != 0;
+    return sidecar;
+}
+
+bool save_index(MappedFile const& file, FileIndex const& index)
+{
+    auto const path = index_path(file);
+    if (!QDir{}.mkpath(QFileInfo{path}.absolutePath())) { return false; }
+
+    auto h = make_header(file);
+    h.truncation = index.truncation;
+    h.record_count = index.records.size();
+    h.extent_count = index.structure.size();
+    h.has_structure = index.has_structure;
+
+    QSaveFile out{path};
+    if (!out.open(QSaveFile::WriteOnly)) { return false; }
+
+    auto const records_size = static_cast<qint64>(index.records.size() * sizeof(std::uint64_t));
+    if (out.write(reinterpret_cast<char const*>(&h), sizeof(h)) != static_cast<qint64>(sizeof(h))) { return false; }
+    if (out.write(reinterpret_cast<char const*>(index.records.data()), records_size) != records_size) { return false; }
+    if (!write_extents(out, index.structure)) { return false; }
+    if (!out.commit()) { return false; }
+
+    prune(QFileInfo{path}.absoluteDir(), path);
+    return true;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGVIEWER_INDEX_FILE_HPP
+#define MSGVIEWER_INDEX_FILE_HPP
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "msgscan/structure.hpp"
+
+#include "mapped_file.hpp"
+
+
+// Read-only view of a contiguous array, owned elsewhere: a vector, or a mapped index file.
+template <class T>
+class ArrayView
+{
+public:
+    ArrayView() = default;
+    ArrayView(T const* first, std::size_t count) : first{first}, count{count} { }
+    explicit ArrayView(std::vector<T> const& v) : first{v.data()}, count{v.size()} { }
+
+    T const* data() const noexcept { return first; }
+    T const* begin() const noexcept { return first; }
+    T const* end() const noexcept { return first + count; }
+    std::size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+
+    T const& operator[](std::size_t i) const noexcept { return first[i]; }
+    T const& back() const noexcept { return first[count - 1]; }
+
+private:
+    T const* first = nullptr;
+    std::size_t count = 0;
+};
+
+
+// What loading a file computes, and what the sidecar index keeps of it.
+struct FileIndex
+{
+    ArrayView<std::uint64_t> records;       // Offset of every top-level object.
+    ArrayView<msgscan::Extent> structure;   // Every non-empty container; see build_structure.
+    std::uint64_t truncation;               // Offset of a truncated last record, or ~0.
+    bool has_structure;                     // Whether `structure` was built at all.
+};
+
+
+// Maps the sidecar index saved for `file`, if there is one and `file` has not changed since:
+// same size, modification time and first and last 64 KiB.  The arrays of `index` then point
+// into the returned mapping.
+std::unique_ptr<MappedFile const> open_index(MappedFile const& file, FileIndex& index);
+
+// Saves `index` as the sidecar index of `file`, replacing any previous one, and removes the
+// oldest indexes of other files if the cache has grown past its limit.  Returns false if it
+// could not be written; the index is a cache, so that is not an error as such.
+bool save_index(MappedFile const& file, FileIndex const& index);
+
+#endif // MSGVIEWER_INDEX_FILE_HPP
@@ -5,14 +5,18 @@
 
 #include <utility>
 #include <memory>
-#include <stack>
+#include <functional>
+#include <future>
+#include <algorithm>
+#include <vector>
+#include <thread>
 #include <cstdint>
 
 #include <QtCore>
 #include <QString>
 #include <QFile>
-#include <QByteArray>
 #include <QVariant>
+#include <QThread>
 
 #include <QObject>
 #include <QApplication>
@@ -21,96 +25,450 @@
 #include <QTreeView>
 #include <QHeaderView>
 #include <QFileDialog>
-#include <QStandardItemModel>
-#include <QStandardItem>
+#include <QAbstractItemModel>
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
+#include <QStatusBar>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QInputDialog>
+#include <QKeySequence>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QScrollBar>
+#include <QSemaphore>
+#include <QLocalSocket>
+#include <QLineEdit>
+#include <QToolBar>
+#include <QVector>
+#include <QDockWidget>
+#include <QTableWidget>
 
-
-
-#ifdef __GNUC__
-#   define COMPILER_GNUC_VERSION (((__GNUC__ * 100) + __GNUC_MINOR__) * 100 + __GNUC_PATCHLEVEL__)
+#ifdef Q_OS_WIN
+#include <io.h>
 #else
-#   define COMPILER_GNUC_VERSION 0
+#include <unistd.h>
 #endif
 
+#include "msgscan/format.hpp"
+#include "msgscan/visitor.hpp"
+#include "msgscan/structure.hpp"
+#include "msgscan/records.hpp"
+#include "msgscan/stream.hpp"
+#include "msgscan/search.hpp"
+#include "msgscan/query.hpp"
+#include "msgscan/schema.hpp"
+#include "msgscan/text.hpp"
 
-#ifndef __has_attribute
-#   define __has_attribute(...) 0
-#endif // !__has_attribute
+#include "mapped_file.hpp"
+#include "index_file.hpp"
+#include "string_pool.hpp"
+#include "flat_map.hpp"
+#include "cli.hpp"
 
-#ifndef __has_builtin
-#   define __has_builtin(...) 0
-#endif // !__has_builtin
 
+// Tree of decoded objects, kept as a flat array of compact nodes over the mapped file.
+// Labels and offsets are formatted on demand in data(), so only visible rows pay for them.
+// Each top-level object is a numbered record.  Only their offsets are collected up front; the
+// node of a record is created the first time the view asks for its row, and a container's
+// children only when it is first expanded (canFetchMore/fetchMore).
+// A container with more than page_size elements shows them in ranges of page_size, or of
+// ranges of those, and so on; each range is only walked when it is expanded.  Without the
+// structure index, a container (or range) of more than background_bytes is walked on its own
+// thread, behind a placeholder row, rather than on the GUI thread.
+// A model of a stream rather than a file keeps only the most recent records, in a window of
+// at most window_capacity bytes; the oldest records are dropped as new ones arrive.
+class ElementWalker;
 
-#if __has_attribute(__always_inline__)
-#   define forceinline inline __attribute__((__always_inline__))
-#elif defined(_MSC_VER)
-#   define forceinline __forceinline
-#else
-#   define forceinline inline
-#endif // forceinline
+class ItemModel final : public QAbstractItemModel
+{
+    Q_OBJECT
 
+    using super = QAbstractItemModel;
 
-#if __has_attribute(noreturn)
-#   define noreturn [[noreturn]]
-#elif defined(_MSC_VER)
-#   define noreturn __declspec(noreturn)
-#else
-#   define noreturn
-#endif
+public:
+    enum class NodeKind : std::uint8_t
+    {
+        object,   // An encoded object starting at `offset`.
+        str_body, // The text of the str whose header is at `offset`.
+        range,    // Consecutive elements of a container, the first of which is at `offset`.
+        pending,  // Stands for the children of its parent while they are found in the background.
+    };
+
+    // Whether the text of a str is UTF-8, checked the first time its label is formatted.
+    enum class Utf8 : std::uint8_t { unknown, valid, invalid };
+
+    // Children of a node are contiguous: nodes[first_child, first_child + child_count).
+    struct Node
+    {
+        std::uint64_t offset;
+        std::uint64_t length; // Encoded size in bytes, nested objects included; for a range,
+                              // the number of elements in it; for a str body, the id of its
+                              // text in `strings`, or StringPool::none; for a pending node,
+                              // the number of elements being walked.
+        std::uint32_t parent; // no_parent for top-level objects.
+        std::uint32_t first_child; // unfetched until the children are decoded.
+        std::uint32_t child_count;
+        std::uint8_t type;    // MessagePack type byte.
+        NodeKind kind;
+        bool truncated;       // Cut short by the end of the file; `length` is what is there.
+        mutable Utf8 utf8 = Utf8::unknown; // For a str object.
+    };
+
+    static constexpr std::uint32_t no_node = ~std::uint32_t{};
+    static constexpr std::uint32_t no_parent = no_node;
+    static constexpr std::uint64_t not_truncated = ~std::uint64_t{};
+    static constexpr std::uint32_t unfetched = 0; // nodes[0] is always a top-level object.
+    static constexpr std::size_t window_capacity = std::size_t{256} << 20;
+    static constexpr std::uint64_t page_size = 10000;
+    static constexpr std::uint64_t background_bytes = std::uint64_t{16} << 20;
+
+    explicit ItemModel(std::unique_ptr<MappedFile const> file) : file{std::move(file)} { }
+
+    // Model of a stream, empty until fed with append_stream().
+    ItemModel() = default;
+
+    QModelIndex index(int row, int column, QModelIndex const& parent = QModelIndex()) const override;
+    QModelIndex parent(QModelIndex const& index) const override;
+    int rowCount(QModelIndex const& parent = QModelIndex()) const override;
+    int columnCount(QModelIndex const& parent = QModelIndex()) const override;
+    QVariant data(QModelIndex const& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(QModelIndex const& index) const override;
+    bool hasChildren(QModelIndex const& parent = QModelIndex()) const override;
+    bool canFetchMore(QModelIndex const& parent) const override;
+    void fetchMore(QModelIndex const& parent) override;
+
+    // Offset of the last record if it runs past the end of the file, or not_truncated.
+    std::uint64_t truncated_at() const noexcept { return truncation; }
+
+    // Maps the file again and appends the records written to it since, decoding only the new
+    // bytes; a truncated last record is replaced by what it has become.  Returns false if the
+    // file can no longer be opened or has shrunk, which following cannot make sense of.
+    bool follow();
+
+    QString filename() const { return file ? file->filename() : QString{}; }
+
+    // Adds the records completed by the next `size` bytes of the stream.  The bytes may end
+    // anywhere, the middle of a header included; the rest of the record comes with later calls.
+    void append_stream(char const* data, std::size_t size);
+
+    // Shows what there is of a record the stream ended in the middle of, as truncated.
+    void end_stream();
+
+    bool is_stream() const noexcept { return !file; }
+
+    // Index of the object at `offset`, decoding only the containers on the way down to it; an
+    // invalid index if no object starts there, or if the elements of a container on the way are
+    // still being walked in the background.
+    QModelIndex locate(std::uint64_t offset);
+
+    std::vector<std::uint64_t> record_offsets() const { return {records.begin(), records.end()}; }
+
+    // Largest offset there is to show, or that a stream may have in its window.
+    std::uint64_t max_offset() const noexcept
+    {
+        return file ? static_cast<std::uint64_t>(file->size()) : std::max<std::uint64_t>(window.size(), std::uint64_t{window_capacity});
+    }
+
+signals:
+    // The children of the container at `parent` were found in the background and replaced its
+    // pending row; a view showing it expanded has seen its only row removed.
+    void adopted(QModelIndex const& parent);
+
+private:
+    friend std::unique_ptr<ItemModel> construct_model(std::unique_ptr<MappedFile const> file, bool index_structure, std::function<bool (qint64)> const& progress);
+
+    Node const& node(QModelIndex const& index) const { return nodes[static_cast<std::size_t>(index.internalId())]; }
+    QString label(Node const& node) const;
 
+    bool index_records(std::function<bool (qint64)> const& progress);
+    std::uint32_t record_node(std::size_t record) const;
+    std::size_t record_of(std::uint64_t offset) const;
+    std::uint32_t decode_children(std::uint32_t parent);
+    void adopt_children(ElementWalker* walker);
+    QModelIndex index_of(std::uint32_t i) const;
+    std::uint64_t extent_bytes(std::uint32_t i) const;
+    std::uint64_t first_element(Node const& range) const;
+    bool skip_one(char const*& p, std::size_t& extent) const;
+    void own_index();
+    msgscan::Extent const* find_extent(std::uint64_t offset) const;
+    void evict(std::size_t count, std::uint64_t shift);
+    void reserve_nodes(std::uint64_t more) const;
 
-inline namespace builtins
+    char const* data_begin() const noexcept { return file ? file->begin() : window.data(); }
+    char const* data_end() const noexcept { return file ? file->end() : window.data() + window.size(); }
+    std::uint64_t records_end() const noexcept;
+
+    std::unique_ptr<MappedFile const> file; // Null for a stream.
+
+    // Grown by index() for records as well as by fetchMore(); nodes are referred to by
+    // position, which stays valid as the array grows.
+    mutable std::vector<Node> nodes;
+    mutable FlatMap<std::uint32_t> record_nodes; // Record to node.
+
+    // Either built while loading, or mapped from the sidecar index of an earlier run.
+    ArrayView<std::uint64_t> records;       // Offset of every top-level object.
+    ArrayView<msgscan::Extent> structure;   // Empty unless the structure pass was run.
+    std::uint64_t truncation = not_truncated;
+
+    std::vector<std::uint64_t> built_records;
+    std::vector<msgscan::Extent> built_structure;
+    std::unique_ptr<MappedFile const> sidecar;
+
+    // The bytes of a stream, from the first record still shown on.
+    std::vector<char> window;
+    msgscan::RecordSplitter splitter;
+    std::uint64_t evicted = 0; // Records dropped from the front of the window so far.
+
+    // Texts of the str bodies decoded so far; kept across evictions, as keys outlive records.
+    StringPool strings;
+};
+
+
+// Decodes a file into an ItemModel on its own thread.  Cancel with requestInterruption();
+// the result, if any, is available from take_model() once the thread has finished.
+// The file is indexed while `teardown`, if valid, is still releasing the previous model; the
+// new model is only handed over once that is done, before it allocates any nodes or strings.
+class Loader final : public QThread
 {
+    Q_OBJECT
+
+    using super = QThread;
+
+public:
+    Loader(QString filename, bool index_structure, std::shared_future<void> teardown, QObject* parent = nullptr)
+      : super{parent}, filename{std::move(filename)}, index_structure{index_structure}, teardown{std::move(teardown)} { }
+    ~Loader() override;
 
-#if !(__has_builtin(__builtin_unreachable) || (40500 <= COMPILER_GNUC_VERSION))
-noreturn inline void __builtin_unreachable() {}
-#endif // !__builtin_unreachable
+    std::unique_ptr<ItemModel> take_model() noexcept { return std::move(model); }
+
+signals:
+    void progressed(qint64 consumed, qint64 total);
+
+protected:
+    void run() override;
+
+private:
+    QString const filename;
+    bool const index_structure;
+    std::shared_future<void> const teardown;
+    std::unique_ptr<ItemModel> model;
+};
 
 
-#if !(__has_builtin(__builtin_bswap16) || (40800 <= COMPILER_GNUC_VERSION))
-forceinline std::uint16_t __builtin_bswap16(std::uint16_t x)
+// Finds the children of a large container (or range) of a file on its own thread, as
+// decode_children would: its `count` elements starting at offset `first`, or ranges of them.
+// The file is mapped again, up to the `size` it had when the walk started.  Cancel with
+// requestInterruption(); the children are available from take_children() once the thread has
+// finished without being cancelled.
+class ElementWalker final : public QThread
 {
-    return (static_cast<std::uint16_t>(                  static_cast<std::uint8_t>(x      )) << 8u)
-         | (static_cast<std::uint16_t>(                  static_cast<std::uint8_t>(x >> 8u))      );
-}
-#endif // !__builtin_bswap16
+    Q_OBJECT
+
+    using super = QThread;
+
+public:
+    // An element (`length` in bytes), or a range (`length` in elements).
+    struct Child
+    {
+        std::uint64_t offset;
+        std::uint64_t length;
+        bool truncated;
+    };
+
+    ElementWalker(QString filename, std::uint64_t size, std::uint32_t node, std::uint64_t first, std::uint64_t count, QObject* parent = nullptr)
+      : super{parent}, filename{std::move(filename)}, size{size}, node{node}, first{first}, count{count} { }
+    ~ElementWalker() override;
+
+    std::vector<Child> take_children() noexcept { return std::move(children); }
 
-#if !(__has_builtin(__builtin_bswap32) || (40300 <= COMPILER_GNUC_VERSION))
-forceinline std::uint32_t __builtin_bswap32(std::uint32_t x)
+    // The node whose children these are, and the offset of its first element.
+    std::uint32_t parent_node() const noexcept { return node; }
+    std::uint64_t first_offset() const noexcept { return first; }
+
+protected:
+    void run() override;
+
+private:
+    QString const filename;
+    std::uint64_t const size;
+    std::uint32_t const node;
+    std::uint64_t const first;
+    std::uint64_t const count;
+    std::vector<Child> children;
+};
+
+
+// Keeps a model up to date with the file it shows while that file is being appended to.
+// Changes are picked up at most every `interval` ms, so that a busy writer costs one batch
+// of new rows per interval rather than one per write.
+class Follower final : public QObject
 {
-    return (static_cast<std::uint32_t>(__builtin_bswap16(static_cast<std::uint16_t>(x       ))) << 16u)
-         | (static_cast<std::uint32_t>(__builtin_bswap16(static_cast<std::uint16_t>(x >> 16u)))       );
-}
-#endif // !__builtin_bswap32
+    Q_OBJECT
+
+    using super = QObject;
+
+public:
+    static constexpr int interval = 100;
+
+    Follower(ItemModel* model, QTreeView* view, QStatusBar* status);
+
+private:
+    void update();
+
+    ItemModel* const model;
+    QTreeView* const view;
+    QStatusBar* const status;
+    QFileSystemWatcher watcher;
+    QTimer timer;
+};
+
 
-#if !(__has_builtin(__builtin_bswap64) || (40300 <= COMPILER_GNUC_VERSION))
-forceinline std::uint64_t __builtin_bswap64(std::uint64_t x)
+// Reads standard input on its own thread, since reading blocks until the producer writes.
+// At most `credits` chunks are in flight: the reader waits for consumed() before reading more,
+// so a producer faster than the view is held back by the pipe instead of filling memory.
+class StdinReader final : public QThread
 {
-    return (static_cast<std::uint64_t>(__builtin_bswap32(static_cast<std::uint32_t>(x       ))) << 32u)
-         | (static_cast<std::uint64_t>(__builtin_bswap32(static_cast<std::uint32_t>(x >> 32u)))       );
-}
-#endif // !__builtin_bswap64
+    Q_OBJECT
+
+    using super = QThread;
+
+public:
+    static constexpr int chunk_size = 64 << 10;
+    static constexpr int credits = 16;
+
+    using super::super;
+
+    // Called once a received chunk has been dealt with.
+    void consumed() { available.release(); }
+
+    // Ends the thread once the read under way, if any, returns; nothing more is received.
+    void stop()
+    {
+        requestInterruption();
+        available.release();
+    }
+
+signals:
+    void received(QByteArray chunk);
 
-} // namespace builtins
+protected:
+    void run() override;
+
+private:
+    QSemaphore available{credits};
+};
 
 
-class ItemModel final : public QStandardItemModel
+// Searches a file on its own thread, over the records it had when the search started, for text
+// or numbers, or for the objects selected by a path query.  Cancel with requestInterruption().
+class Searcher final : public QThread
 {
-    using super = QStandardItemModel;
+    Q_OBJECT
+
+    using super = QThread;
 
 public:
-    ItemModel() : super{0, 2} { }
+    Searcher(ItemModel const& model, msgscan::Query query, QObject* parent = nullptr)
+      : super{parent}, filename{model.filename()}, size{model.max_offset()}, records{model.record_offsets()}, query{std::move(query)}, by_path{false} { }
+    Searcher(ItemModel const& model, msgscan::PathQuery path, QObject* parent = nullptr)
+      : super{parent}, filename{model.filename()}, size{model.max_offset()}, records{model.record_offsets()}, path{std::move(path)}, by_path{true} { }
+    ~Searcher() override;
 
-    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+signals:
+    // Offsets of the matches found since the last time, in file order.
+    void found(QVector<quint64> hits);
+    // For a path query, the same matches with the path and value of each, up to max_described.
+    void described(QVector<quint64> hits, QStringList paths, QStringList values);
+    void progressed(qint64 consumed, qint64 total);
+
+protected:
+    void run() override;
+
+private:
+    static constexpr std::size_t max_described = 100000;
+
+    QString const filename;
+    std::uint64_t const size;
+    std::vector<std::uint64_t> const records;
+    msgscan::Query const query;
+    msgscan::PathQuery const path;
+    bool const by_path;
+};
+
+
+// Infers the schema of a file on its own thread, over the records it had when started.  Cancel
+// with requestInterruption(); the result is available from take_schema() once the thread has
+// finished without being cancelled.
+class SchemaBuilder final : public QThread
+{
+    Q_OBJECT
+
+    using super = QThread;
+
+public:
+    SchemaBuilder(ItemModel const& model, QObject* parent = nullptr)
+      : super{parent}, filename{model.filename()}, size{model.max_offset()}, records{model.record_offsets()} { }
+    ~SchemaBuilder() override;
+
+    std::unique_ptr<msgscan::Schema> take_schema() noexcept { return std::move(schema); }
+
+signals:
+    void progressed(qint64 consumed, qint64 total);
+
+protected:
+    void run() override;
+
+private:
+    QString const filename;
+    std::uint64_t const size;
+    std::vector<std::uint64_t> const records;
+    std::unique_ptr<msgscan::Schema> schema;
+};
+
+
+// The matches of a query in the model shown by a view, found in the background, and which of
+// them is selected.  Matches can be stepped through while they are still being found.
+class Search final : public QObject
+{
+    Q_OBJECT
+
+    using super = QObject;
+
+public:
+    // Takes `searcher` over, and starts it.
+    Search(ItemModel* model, QTreeView* view, QStatusBar* status, Searcher* searcher);
+
+    // Selects the next (or previous) match, wrapping around.
+    void step(bool forward);
+
+private:
+    void select(std::size_t hit);
+    void report();
+
+    ItemModel* const model;
+    QTreeView* const view;
+    QStatusBar* const status;
+    Searcher* const searcher;
+    std::vector<std::uint64_t> hits;
+    std::size_t current = 0;
+    qint64 consumed = 0;
+    qint64 total = 0;
+    bool finished = false;
 };
 
 
+void fit_columns(QTreeView* view, std::uint64_t max_offset);
+
+
 int main(int argc, char** argv)
 {
+    // Headless commands run without a display, before any widget is created.
+    auto const code = run_cli(argc, argv);
+    if (code >= 0) { return code; }
+
     QApplication a(argc, argv);
 
     QMainWindow window;
@@ -120,6 +478,12 @@ int main(int argc, char** argv)
 
     view->setSelectionBehavior(QAbstractItemView::SelectRows);
 
+    // Lets the view lay out only the visible rows, measuring a single one for their height.
+    view->setUniformRowHeights(true);
+
+    auto status = window.statusBar();
+    Q_ASSERT(status);
+
     auto bar = new QMenuBar;
     Q_ASSERT(bar);
     window.setMenuBar(bar);
@@ -127,10 +491,83 @@ int main(int argc, char** argv)
     auto file = bar->addMenu(QStringLiteral("File"));
     Q_ASSERT(file);
 
+    auto index = file->addAction(QStringLiteral("Index Structure on Open"));
+    Q_ASSERT(index);
+    index->setCheckable(true);
+
+    auto follow = file->addAction(QStringLiteral("Follow File"));
+    Q_ASSERT(follow);
+    follow->setCheckable(true);
+
+    void set_following(QTreeView* view, QStatusBar* status, bool enable);
+    QObject::connect(follow, &QAction::toggled, [=](bool checked){ set_following(view, status, checked); });
+
     if (auto a = file->addAction(QStringLiteral("Open")))
     {
-        void open_serialized_file(QTreeView* view);
-        QObject::connect(a, &QAction::triggered, [=]{ open_serialized_file(view); });
+        void open_serialized_file(QTreeView* view, QStatusBar* status, bool index_structure, bool follow);
+        QObject::connect(a, &QAction::triggered, [=]{ open_serialized_file(view, status, index->isChecked(), follow->isChecked()); });
+    }
+
+    auto search_bar = window.addToolBar(QStringLiteral("Search"));
+    Q_ASSERT(search_bar);
+
+    auto query = new QLineEdit;
+    query->setPlaceholderText(QStringLiteral("Search keys and values, or query .path[*] where .key == value"));
+    search_bar->addWidget(query);
+
+    void start_search(QTreeView* view, QStatusBar* status, QString const& text);
+    QObject::connect(query, &QLineEdit::returnPressed, [=]{ start_search(view, status, query->text()); });
+
+    auto go = bar->addMenu(QStringLiteral("Go"));
+    Q_ASSERT(go);
+
+    if (auto a = go->addAction(QStringLiteral("Find...")))
+    {
+        a->setShortcut(QKeySequence::Find);
+        QObject::connect(a, &QAction::triggered, [=]{ query->setFocus(); query->selectAll(); });
+    }
+
+    void step_search(QTreeView* view, bool forward);
+    if (auto a = go->addAction(QStringLiteral("Next Match")))
+    {
+        a->setShortcut(QKeySequence::FindNext);
+        QObject::connect(a, &QAction::triggered, [=]{ step_search(view, true); });
+    }
+    if (auto a = go->addAction(QStringLiteral("Previous Match")))
+    {
+        a->setShortcut(QKeySequence::FindPrevious);
+        QObject::connect(a, &QAction::triggered, [=]{ step_search(view, false); });
+    }
+
+    if (auto a = go->addAction(QStringLiteral("Record...")))
+    {
+        a->setShortcut(QKeySequence{QStringLiteral("Ctrl+G")});
+
+        void go_to_record(QTreeView* view);
+        QObject::connect(a, &QAction::triggered, [=]{ go_to_record(view); });
+    }
+
+    auto panels = bar->addMenu(QStringLiteral("View"));
+    Q_ASSERT(panels);
+
+    if (auto a = panels->addAction(QStringLiteral("Schema")))
+    {
+        void show_schema(QMainWindow* window, QTreeView* view, QStatusBar* status, QLineEdit* query);
+        QObject::connect(a, &QAction::triggered, [=, &window]{ show_schema(&window, view, status, query); });
+    }
+
+    // `msgviewer -` shows the records piped to it, `msgviewer --socket PATH` those sent over a
+    // local socket.
+    auto const args = QCoreApplication::arguments();
+    if (args.size() == 2 && args[1] == QStringLiteral("-"))
+    {
+        void open_stream(QTreeView* view, QStatusBar* status, QString const& socket);
+        open_stream(view, status, {});
+    }
+    else if (args.size() == 3 && args[1] == QStringLiteral("--socket"))
+    {
+        void open_stream(QTreeView* view, QStatusBar* status, QString const& socket);
+        open_stream(view, status, args[2]);
     }
 
     window.show();
@@ -139,375 +576,1582 @@ int main(int argc, char** argv)
 }
 
 
-void open_serialized_file(QTreeView* view)
+void open_serialized_file(QTreeView* view, QStatusBar* status, bool index_structure, bool follow)
 {
-    QByteArray data;
+    auto filename = QFileDialog::getOpenFileName();
+    if (filename.isEmpty()) { return; }
 
+    // Abandon a load still in flight; its result, if any, is dropped when it finishes.
+    for (auto loader : view->findChildren<Loader*>())
     {
-        auto filename = QFileDialog::getOpenFileName();
-        if (filename.isEmpty()) { return; }
+        loader->requestInterruption();
+    }
 
-        QFile file{filename};
-        if (!file.open(QFile::ReadOnly)) { return; }
+    void set_following(QTreeView* view, QStatusBar* status, bool enable);
+    set_following(view, status, false);
 
-        data = file.readAll();
-    }
+    void stop_search(QTreeView* view);
+    stop_search(view);
+
+    std::shared_future<void> dispose_model(QAbstractItemModel* model);
 
     // Take previous model and release it, before constructing new model (for less memory usage).
+    // It is released on another thread while the new file is indexed; the new one is only shown,
+    // and decoded, once that is done.
+    std::shared_future<void> teardown;
     if (auto m = view->model())
     {
         view->setModel(nullptr);
-        delete m;
+        teardown = dispose_model(m);
     }
 
-    void construct_model(QTreeView* view, QByteArray data);
-    construct_model(view, std::move(data));
+    auto loader = new Loader{std::move(filename), index_structure, std::move(teardown), view};
 
-    // Adjust header viewing.
-    view->header()->setStretchLastSection(false);
-    view->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
-    view->header()->setSectionResizeMode(0, QHeaderView::Stretch);
-}
+    auto progress = new QProgressBar;
+    progress->setRange(0, 1000);
+    progress->setValue(0);
+    status->addPermanentWidget(progress);
 
+    auto cancel = new QPushButton{QStringLiteral("Cancel")};
+    status->addPermanentWidget(cancel);
 
-static forceinline std::uint16_t loadbe16(void const* ptr)
-{
-    return __builtin_bswap16(*reinterpret_cast<std::uint16_t const*>(ptr));
-}
-static forceinline std::uint32_t loadbe32(void const* ptr)
-{
-    return __builtin_bswap32(*reinterpret_cast<std::uint32_t const*>(ptr));
+    QObject::connect(cancel, &QPushButton::clicked, loader, &QThread::requestInterruption);
+    QObject::connect(loader, &Loader::progressed, progress, [=](qint64 consumed, qint64 total)
+    {
+        progress->setValue(total ? static_cast<int>(consumed * 1000 / total) : 1000);
+    });
+    QObject::connect(loader, &QThread::finished, view, [=]
+    {
+        delete progress;
+        delete cancel;
+        loader->deleteLater();
+
+        auto model = loader->take_model();
+        if (!model) { return; }
+
+        if (loader->isInterruptionRequested())
+        {
+            dispose_model(model.release());
+            return;
+        }
+
+        if (model->truncated_at() != ItemModel::not_truncated)
+        {
+            status->showMessage(QStringLiteral("File ends in the middle of the object at offset %1").arg(model->truncated_at(), 0, 16));
+        }
+
+        // A container left without rows while its elements were walked is collapsed.
+        QObject::connect(model.get(), &ItemModel::adopted, view, [view](QModelIndex const& parent) { view->expand(parent); });
+
+        // To avoid memory leak on quitting.
+        model->setParent(QCoreApplication::instance());
+        auto const max_offset = model->max_offset();
+        view->setModel(model.release());
+
+        fit_columns(view, max_offset);
+
+        if (follow) { set_following(view, status, true); }
+    });
+
+    loader->start();
 }
-static forceinline std::uint64_t loadbe64(void const* ptr)
+
+
+// Sizes the columns without measuring any row, which ResizeToContents would do for every row on
+// each expansion: the data column takes the width left, and the offset column is made wide
+// enough for `max_offset` in hex.  Never narrows the offset column.
+void fit_columns(QTreeView* view, std::uint64_t max_offset)
 {
-    return __builtin_bswap64(*reinterpret_cast<std::uint64_t const*>(ptr));
+    auto const header = view->header();
+    header->setStretchLastSection(false);
+    header->setSectionResizeMode(0, QHeaderView::Stretch);
+    header->setSectionResizeMode(1, QHeaderView::Interactive);
+
+    // Two more digits' worth for the margins.
+    auto const digits = QString{QString::number(max_offset, 16).size() + 2, QLatin1Char('0')};
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    auto const width = std::max(view->fontMetrics().horizontalAdvance(digits), header->sectionSizeHint(1));
+#else
+    auto const width = std::max(view->fontMetrics().width(digits), header->sectionSizeHint(1));
+#endif
+    if (header->sectionSize(1) < width) { header->resizeSection(1, width); }
 }
 
 
-QVariant ItemModel::headerData(int section, Qt::Orientation orientation, int role) const
+// Starts or stops following the file of the current model.
+void set_following(QTreeView* view, QStatusBar* status, bool enable)
 {
-    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
+    for (auto follower : view->findChildren<Follower*>())
     {
-        static const QVariant v_data{QStringLiteral("Data (Type/Value/...)")};
-        static const QVariant v_offset{QStringLiteral("Offset in HEX (Byte)")};
+        delete follower;
+    }
 
-        switch (section)
-        {
-        case 0: return v_data;
-        case 1: return v_offset;
-        }
+    if (!enable) { return; }
+
+    auto model = dynamic_cast<ItemModel*>(view->model());
+    if (model && !model->is_stream())
+    {
+        new Follower{model, view, status};
     }
-    return super::headerData(section, orientation, role);
 }
 
 
-void construct_model(QTreeView* view, QByteArray const data)
+// Shows the records arriving on standard input, or on the local socket `socket` if not empty,
+// as they come.  The stream stays open for as long as the model is shown.
+void open_stream(QTreeView* view, QStatusBar* status, QString const& socket)
 {
-    auto model = std::make_unique<ItemModel>();
-
-    // To avoid memory leak on quitting.
+    auto model = new ItemModel;
     model->setParent(QCoreApplication::instance());
+    view->setModel(model);
 
-    std::stack<std::pair<QStandardItem*, unsigned>> ctx;
-    ctx.push(std::make_pair(model->invisibleRootItem(), 0));
+    fit_columns(view, model->max_offset());
 
-    QList<QStandardItem*> buffer{{nullptr, nullptr}};
-    auto const _insert = [&](QString label, Qt::ItemFlags flags, std::ptrdiff_t offset)
+    // Keep the newest records in sight, unless the user has scrolled away from them.
+    auto append = [=](char const* data, std::size_t size)
     {
-        buffer[0] = new QStandardItem(std::move(label));
-        buffer[0]->setFlags(flags | Qt::ItemIsEnabled | Qt::ItemIsSelectable);
-        buffer[1] = new QStandardItem(QString::number(offset, 16));
-        ctx.top().first->appendRow(buffer);
-        return buffer[0];
+        auto const bar = view->verticalScrollBar();
+        auto const at_bottom = bar->value() == bar->maximum();
+        model->append_stream(data, size);
+        if (at_bottom) { view->scrollToBottom(); }
     };
-    auto const insert = [&](QString label, std::ptrdiff_t offset)
+    auto end = [=](QString const& message)
     {
-        return _insert(std::move(label), Qt::ItemNeverHasChildren, offset);
+        model->end_stream();
+        status->showMessage(message);
     };
-    auto const push = [&](QString label, unsigned len, std::ptrdiff_t offset)
+
+    if (socket.isEmpty())
+    {
+        // Never waited for: it may be blocked reading when the application quits.
+        auto reader = new StdinReader;
+        QObject::connect(reader, &StdinReader::received, model, [=](QByteArray const& chunk)
+        {
+            append(chunk.constData(), static_cast<std::size_t>(chunk.size()));
+            reader->consumed();
+        });
+        QObject::connect(reader, &QThread::finished, model, [=]{ end(QStringLiteral("End of input")); });
+        QObject::connect(reader, &QThread::finished, reader, &QObject::deleteLater);
+
+        // The reader waits for the model to take each chunk before reading on, which a model
+        // deleted by dispose_model() never will.  Called on the GUI thread, so a reader that has
+        // already finished and gone is not called at all.
+        QObject::connect(model, &QObject::destroyed, reader, &StdinReader::stop);
+
+        status->showMessage(QStringLiteral("Reading standard input"));
+        reader->start();
+        return;
+    }
+
+    auto connection = new QLocalSocket{model};
+    // Bounds what is read ahead of the view; the sender waits on the socket beyond that.
+    connection->setReadBufferSize(StdinReader::chunk_size * StdinReader::credits);
+
+    QObject::connect(connection, &QLocalSocket::readyRead, model, [=]
+    {
+        auto const chunk = connection->readAll();
+        append(chunk.constData(), static_cast<std::size_t>(chunk.size()));
+    });
+    QObject::connect(connection, &QLocalSocket::disconnected, model, [=]{ end(QStringLiteral("Disconnected from %1").arg(socket)); });
+    auto const failed = [=](QLocalSocket::LocalSocketError error)
     {
-        ctx.push(std::make_pair(_insert(std::move(label), Qt::NoItemFlags, offset), len));
+        // The sender closing the connection is reported as an error too.
+        if (error == QLocalSocket::PeerClosedError) { return; }
+        status->showMessage(QStringLiteral("Cannot read %1: %2").arg(socket, connection->errorString()));
     };
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    QObject::connect(connection, &QLocalSocket::errorOccurred, model, failed);
+#else
+    QObject::connect(connection, static_cast<void (QLocalSocket::*)(QLocalSocket::LocalSocketError)>(&QLocalSocket::error), model, failed);
+#endif
 
-    for (char const* itr = data.begin(), * end = data.end(); itr != end; ++itr)
+    status->showMessage(QStringLiteral("Reading %1").arg(socket));
+    connection->connectToServer(socket, QIODevice::ReadOnly);
+}
+
+
+// Starts looking for `text` in the model shown; a search still going on is abandoned.  Text
+// that reads as an integer also matches integers of that value.  Text starting with '.' or
+// '[' is a path query instead (see msgscan/query.hpp), matching the objects it selects.
+void start_search(QTreeView* view, QStatusBar* status, QString const& text)
+{
+    void stop_search(QTreeView* view);
+    stop_search(view);
+
+    if (text.isEmpty()) { return; }
+
+    auto model = dynamic_cast<ItemModel*>(view->model());
+    if (!model) { return; }
+    if (model->is_stream())
     {
-        auto const offset = std::ptrdiff_t{itr - data.begin()};
-        auto const byte = static_cast<unsigned char>(*itr);
+        status->showMessage(QStringLiteral("Streams cannot be searched"));
+        return;
+    }
 
-        if (byte <= 0x7fu)
-        {
-            insert(QStringLiteral("positive fixint: %1").arg(byte), offset);
-        }
-        else if (byte <= 0x8fu)
-        {
-            if (auto len = byte - 0x80u)
-            {
-                push(QStringLiteral("fixmap: count %1").arg(len), len * 2, offset);
-            }
-            else
-            {
-                insert(QStringLiteral("fixmap: empty"), offset);
-            }
-        }
-        else if (byte <= 0x9fu)
-        {
-            if (auto len = byte - 0x90u)
-            {
-                push(QStringLiteral("fixarray: count %1").arg(len), len, offset);
-            }
-            else
-            {
-                insert(QStringLiteral("fixarray: empty"), offset);
-            }
-        }
-        else if (byte <= 0xbfu)
-        {
-            auto len = byte - 0xa0u;
-            auto str = QString::fromUtf8(itr + 1, len);
-            itr += len;
-            if (len)
-            {
-                push(QStringLiteral("fixstr: length %1").arg(len), 1, offset);
-                insert(std::move(str), offset);
-            }
-            else
-            {
-                insert(QStringLiteral("fixstr: empty"), offset);
-            }
-        }
-        else if (byte <= 0xdfu)
+    if (text.startsWith(QLatin1Char('.')) || text.startsWith(QLatin1Char('[')))
+    {
+        msgscan::PathQuery path;
+        if (auto const error = msgscan::parse(text.toStdString(), path))
         {
-            switch (byte)
-            {
-            case 0xc0u: insert(QStringLiteral("nil"), offset); break;
-            case 0xc1u: insert(QStringLiteral("(never used)"), offset); break;
-            case 0xc2u: insert(QStringLiteral("false"), offset); break;
-            case 0xc3u: insert(QStringLiteral("true"), offset); break;
-            case 0xc4u:
-              {
-                auto len = *reinterpret_cast<std::uint8_t const*>(itr + 1);
-                itr += len + 1;
-                insert(QStringLiteral("bin 8: length %1").arg(len), offset);
-              }
-              break;
-            case 0xc5u:
-              {
-                auto len = loadbe16(itr + 1);
-                itr += len + 1;
-                insert(QStringLiteral("bin 16: length %1").arg(len), offset);
-              }
-              break;
-            case 0xc6u:
-              {
-                auto len = loadbe32(itr + 1);
-                itr += len + 1;
-                insert(QStringLiteral("bin 32: length %1").arg(len), offset);
-              }
-              break;
-            case 0xc7u:
-              {
-                auto len = *reinterpret_cast<std::uint8_t const*>(itr + 1);
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 2);
-                itr += len + 2;
-                insert(QStringLiteral("ext 8: type %1 length %2").arg(type).arg(len), offset);
-              }
-              break;
-            case 0xc8u:
-              {
-                auto len = loadbe16(itr + 1);
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 3);
-                itr += len + 3;
-                insert(QStringLiteral("ext 16: type %1 length %2").arg(type).arg(len), offset);
-              }
-              break;
-            case 0xc9u:
-              {
-                auto len = loadbe32(itr + 1);
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 5);
-                itr += len + 5;
-                insert(QStringLiteral("ext 32: type %1 length %2").arg(type).arg(len), offset);
-              }
-              break;
-            case 0xcau:
-              {
-                union { std::uint32_t i; float f; } value = {loadbe32(itr + 1)};
-                itr += 4;
-                insert(QStringLiteral("float32: %1").arg(value.f), offset);
-              }
-              break;
-            case 0xcbu:
-              {
-                union { std::uint64_t i; double d; } value = {loadbe64(itr + 1)};
-                itr += 8;
-                insert(QStringLiteral("float64: %1").arg(value.d), offset);
-              }
-              break;
-            case 0xccu:
-              {
-                auto value = *reinterpret_cast<std::uint8_t const*>(itr + 1);
-                itr += 1;
-                insert(QStringLiteral("uint8: %1").arg(value), offset);
-              }
-              break;
-            case 0xcdu:
-              {
-                auto value = loadbe16(itr + 1);
-                itr += 2;
-                insert(QStringLiteral("uint16: %1").arg(value), offset);
-              }
-              break;
-            case 0xceu:
-              {
-                auto value = loadbe32(itr + 1);
-                itr += 4;
-                insert(QStringLiteral("uint32: %1").arg(value), offset);
-              }
-              break;
-            case 0xcfu:
-              {
-                auto value = loadbe64(itr + 1);
-                itr += 8;
-                insert(QStringLiteral("uint64: %1").arg(value), offset);
-              }
-              break;
-            case 0xd0u:
-              {
-                auto value = *reinterpret_cast<std::uint8_t const*>(itr + 1);
-                itr += 1;
-                insert(QStringLiteral("int8: %1").arg(value), offset);
-              }
-              break;
-            case 0xd1u:
-              {
-                auto value = static_cast<std::int16_t>(loadbe16(itr + 1));
-                itr += 2;
-                insert(QStringLiteral("int16: %1").arg(value), offset);
-              }
-              break;
-            case 0xd2u:
-              {
-                auto value = static_cast<std::int32_t>(loadbe32(itr + 1));
-                itr += 4;
-                insert(QStringLiteral("int32: %1").arg(value), offset);
-              }
-              break;
-            case 0xd3u:
-              {
-                auto value = static_cast<std::int64_t>(loadbe64(itr + 1));
-                itr += 8;
-                insert(QStringLiteral("int64: %1").arg(value), offset);
-              }
-              break;
-            case 0xd4u:
-              {
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 1);
-                itr += 2;
-                insert(QStringLiteral("fixext 1: type %1").arg(type), offset);
-              }
-              break;
-            case 0xd5u:
-              {
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 1);
-                itr += 3;
-                insert(QStringLiteral("fixext 2: type %1").arg(type), offset);
-              }
-              break;
-            case 0xd6u:
-              {
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 1);
-                itr += 5;
-                insert(QStringLiteral("fixext 4: type %1").arg(type), offset);
-              }
-              break;
-            case 0xd7u:
-              {
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 1);
-                itr += 9;
-                insert(QStringLiteral("fixext 8: type %1").arg(type), offset);
-              }
-              break;
-            case 0xd8:
-              {
-                auto type = *reinterpret_cast<std::int8_t const*>(itr + 1);
-                itr += 17;
-                insert(QStringLiteral("fixext 16: type %1").arg(type), offset);
-              }
-              break;
-            case 0xd9:
-              {
-                auto len = *reinterpret_cast<std::uint8_t const*>(itr + 1);
-                auto str = QString::fromUtf8(itr + 2, len);
-                itr += len + 1;
-                push(QStringLiteral("str 8: length %1").arg(len), 1, offset);
-                insert(std::move(str), offset);
-              }
-              break;
-            case 0xda:
-              {
-                auto len = loadbe16(itr + 1);
-                auto str = QString::fromUtf8(itr + 2, len);
-                itr += len + 1;
-                push(QStringLiteral("str 16: length %1").arg(len), 1, offset);
-                insert(std::move(str), offset);
-              }
-              break;
-            case 0xdb:
-              {
-                auto len = loadbe32(itr + 1);
-                auto str = QString::fromUtf8(itr + 2, len);
-                itr += len + 1;
-                push(QStringLiteral("str 32: length %1").arg(len), 1, offset);
-                insert(std::move(str), offset);
-              }
-              break;
-            case 0xdc:
-              {
-                auto len = loadbe16(itr + 1);
-                itr += 2;
-                push(QStringLiteral("array 16: count %1").arg(len), len, offset);
-              }
-              break;
-            case 0xdd:
-              {
-                auto len = loadbe32(itr + 1);
-                itr += 4;
-                push(QStringLiteral("array 32: count %1").arg(len), len, offset);
-              }
-              break;
-            case 0xde:
-              {
-                auto len = loadbe16(itr + 1);
-                itr += 2;
-                push(QStringLiteral("map 16: count %1").arg(len), len * 2, offset);
-              }
-              break;
-            case 0xdf:
-              {
-                auto len = loadbe32(itr + 1);
-                itr += 4;
-                push(QStringLiteral("map 32: count %1").arg(len), len * 2, offset);
-              }
-              break;
-            default:
-              __builtin_unreachable();
-              Q_ASSERT(!"FIXME: should not reach here.");
-              break;
-            }
+            status->showMessage(QStringLiteral("Invalid query: %1").arg(QString::fromLatin1(error)));
+            return;
         }
-        else /*if (byte <= 0xffu)*/
+        auto const searcher = new Searcher{*model, std::move(path)};
+        void show_results(ItemModel* model, QTreeView* view, Searcher* searcher);
+        show_results(model, view, searcher);
+        new Search{model, view, status, searcher};
+        return;
+    }
+
+    msgscan::Query query;
+    query.text = text.toStdString();
+    query.number = text.toLongLong(&query.match_number);
+
+    new Search{model, view, status, new Searcher{*model, std::move(query)}};
+}
+
+void step_search(QTreeView* view, bool forward)
+{
+    for (auto search : view->findChildren<Search*>())
+    {
+        search->step(forward);
+    }
+}
+
+void stop_search(QTreeView* view)
+{
+    for (auto search : view->findChildren<Search*>())
+    {
+        delete search;
+    }
+
+    // The matches listed are those of the search just stopped.
+    if (auto dock = view->window()->findChild<QDockWidget*>(QStringLiteral("results")))
+    {
+        static_cast<QTableWidget*>(dock->widget())->setRowCount(0);
+    }
+}
+
+// Lists the matches of a path query in a dock panel as they are found, with the path and value
+// of each.  The table sorts by any column; activating a match selects it.
+void show_results(ItemModel* model, QTreeView* view, Searcher* searcher)
+{
+    auto window = qobject_cast<QMainWindow*>(view->window());
+    if (!window) { return; }
+
+    auto dock = window->findChild<QDockWidget*>(QStringLiteral("results"));
+    QTableWidget* table;
+    if (dock)
+    {
+        table = static_cast<QTableWidget*>(dock->widget());
+    }
+    else
+    {
+        dock = new QDockWidget{QStringLiteral("Results"), window};
+        dock->setObjectName(QStringLiteral("results"));
+
+        table = new QTableWidget{0, 3};
+        table->setHorizontalHeaderLabels(QStringList{QStringLiteral("Offset in HEX (Byte)"), QStringLiteral("Path"), QStringLiteral("Value")});
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        dock->setWidget(table);
+        window->addDockWidget(Qt::BottomDockWidgetArea, dock);
+
+        QObject::connect(table, &QTableWidget::cellActivated, [=](int row, int)
         {
-            auto value = static_cast<std::int8_t>(byte);
-            insert(QStringLiteral("negative fixint: %1").arg(value), offset);
-        }
+            auto model = dynamic_cast<ItemModel*>(view->model());
+            if (!model) { return; }
 
-        while (ctx.top().second == static_cast<unsigned>(ctx.top().first->rowCount()))
+            auto const index = model->locate(table->item(row, 0)->data(Qt::UserRole).toULongLong());
+            if (!index.isValid()) { return; }
+
+            view->setCurrentIndex(index);
+            view->scrollTo(index, QAbstractItemView::PositionAtCenter);
+        });
+    }
+    dock->show();
+    table->setSortingEnabled(false);
+    table->setRowCount(0);
+
+    // Offsets are padded to the same width, so that they sort by value.
+    auto const width = QString::number(model->max_offset(), 16).size();
+    QObject::connect(searcher, &Searcher::described, table, [=](QVector<quint64> const& hits, QStringList const& paths, QStringList const& values)
+    {
+        auto row = table->rowCount();
+        table->setRowCount(row + hits.size());
+        for (int i = 0; i != hits.size(); ++i, ++row)
         {
-            ctx.pop();
+            auto const offset = new QTableWidgetItem{QStringLiteral("%1").arg(hits[i], width, 16, QLatin1Char('0'))};
+            offset->setData(Qt::UserRole, static_cast<qulonglong>(hits[i]));
+            table->setItem(row, 0, offset);
+            table->setItem(row, 1, new QTableWidgetItem{paths[i]});
+            table->setItem(row, 2, new QTableWidgetItem{values[i]});
         }
-        Q_ASSERT(!ctx.empty());
-    }
+    });
+    QObject::connect(searcher, &QThread::finished, table, [=]
+    {
+        table->resizeColumnsToContents();
+        table->setSortingEnabled(true);
+    });
+}
 
-    // TODO: indicate insufficients
 
-    view->setModel(model.release());
-}
+// Infers the schema of the file shown, and lists its paths in a dock panel, with the kinds,
+// lengths and numeric ranges of the objects found at each, and the bytes they take: in all,
+// in headers and map keys, and by kind.  The table sorts by any column; by bytes, it shows which
+// paths weigh the most.  Activating a path queries it.
+void show_schema(QMainWindow* window, QTreeView* view, QStatusBar* status, QLineEdit* query)
+{
+    auto model = dynamic_cast<ItemModel*>(view->model());
+    if (!model) { return; }
+    if (model->is_stream())
+    {
+        status->showMessage(QStringLiteral("Streams have no schema"));
+        return;
+    }
+
+    auto dock = window->findChild<QDockWidget*>(QStringLiteral("schema"));
+    QTableWidget* table;
+    if (dock)
+    {
+        table = static_cast<QTableWidget*>(dock->widget());
+
+        // A pass still going on is for an earlier file, or the same; either way it is redone.
+        for (auto builder : dock->findChildren<SchemaBuilder*>())
+        {
+            delete builder;
+        }
+    }
+    else
+    {
+        dock = new QDockWidget{QStringLiteral("Schema"), window};
+        dock->setObjectName(QStringLiteral("schema"));
+
+        // Columns are set once the kinds found are known.
+        table = new QTableWidget{0, 0};
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        dock->setWidget(table);
+        window->addDockWidget(Qt::RightDockWidgetArea, dock);
+
+        void start_search(QTreeView* view, QStatusBar* status, QString const& text);
+        QObject::connect(table, &QTableWidget::cellActivated, [=](int row, int)
+        {
+            auto const path = table->item(row, 0)->text();
+            query->setText(path);
+            start_search(view, status, path);
+        });
+    }
+    dock->show();
+    table->setSortingEnabled(false);
+    table->setRowCount(0);
+
+    auto builder = new SchemaBuilder{*model, dock};
+    QObject::connect(builder, &SchemaBuilder::progressed, dock, [=](qint64 consumed, qint64 total)
+    {
+        status->showMessage(QStringLiteral("Inferring schema (%1%)").arg(total ? consumed * 100 / total : 0));
+    });
+    QObject::connect(builder, &QThread::finished, dock, [=]
+    {
+        builder->deleteLater();
+
+        auto const schema = builder->take_schema();
+        if (!schema) { return; }
+
+        // Numbers are kept as such, so that the columns sort by value rather than as text.
+        auto const number = [](std::uint64_t n)
+        {
+            auto const item = new QTableWidgetItem;
+            item->setData(Qt::DisplayRole, static_cast<qulonglong>(n));
+            return item;
+        };
+
+        auto const report = schema->report();
+
+        // Bytes by kind, for the kinds found anywhere, and of map keys, then the rest.
+        using Row = std::pair<std::string, msgscan::Shape>;
+        std::vector<std::size_t> present;
+        for (std::size_t k = 0; k != msgscan::Shape::kind_count; ++k)
+        {
+            if (std::any_of(report.begin(), report.end(), [=](Row const& r) { return r.second.kinds[k] != 0; })) { present.push_back(k); }
+        }
+        auto const keys = std::any_of(report.begin(), report.end(), [](Row const& r) { return r.second.keys != 0; });
+
+        QStringList labels{QStringLiteral("Path"), QStringLiteral("Count"), QStringLiteral("Bytes"), QStringLiteral("Overhead")};
+        for (auto k : present)
+        {
+            labels << QStringLiteral("%1 bytes").arg(QString::fromLatin1(msgscan::Shape::kind_name(static_cast<msgscan::Shape::Kind>(k))));
+        }
+        if (keys) { labels << QStringLiteral("key bytes"); }
+        auto const rest = labels.size();
+        labels << QStringLiteral("Kinds") << QStringLiteral("Length") << QStringLiteral("Value");
+
+        table->setColumnCount(labels.size());
+        table->setHorizontalHeaderLabels(labels);
+        table->setRowCount(static_cast<int>(report.size()));
+        for (std::size_t i = 0; i != report.size(); ++i)
+        {
+            auto const& shape = report[i].second;
+
+            QStringList kinds;
+            for (std::size_t k = 0; k != msgscan::Shape::kind_count; ++k)
+            {
+                if (!shape.kinds[k]) { continue; }
+                kinds << QStringLiteral("%1 %2").arg(QString::fromLatin1(msgscan::Shape::kind_name(static_cast<msgscan::Shape::Kind>(k)))).arg(shape.kinds[k]);
+            }
+
+            auto const row = static_cast<int>(i);
+            table->setItem(row, 0, new QTableWidgetItem{QString::fromStdString(report[i].first)});
+            table->setItem(row, 1, number(shape.count));
+            table->setItem(row, 2, number(shape.total_bytes()));
+            table->setItem(row, 3, number(shape.overhead_bytes()));
+            auto column = 4;
+            for (auto k : present)
+            {
+                table->setItem(row, column++, number(shape.bytes[k]));
+            }
+            if (keys) { table->setItem(row, column++, number(shape.key_bytes)); }
+            table->setItem(row, rest, new QTableWidgetItem{kinds.join(QStringLiteral(", "))});
+            if (shape.has_length())
+            {
+                table->setItem(row, rest + 1, new QTableWidgetItem{QStringLiteral("%1..%2").arg(shape.min_length).arg(shape.max_length)});
+            }
+            if (shape.has_value())
+            {
+                table->setItem(row, rest + 2, new QTableWidgetItem{QStringLiteral("%1..%2").arg(shape.min_value, 0, 'g', 15).arg(shape.max_value, 0, 'g', 15)});
+            }
+        }
+        table->resizeColumnsToContents();
+        table->setSortingEnabled(true);
+        status->showMessage(QStringLiteral("%1 paths").arg(report.size()));
+    });
+    builder->start();
+}
+
+
+// Asks for a record number and selects that record.
+void go_to_record(QTreeView* view)
+{
+    auto model = view->model();
+    if (!model || model->rowCount() == 0) { return; }
+
+    auto ok = false;
+    auto const row = QInputDialog::getInt(view, QStringLiteral("Go to Record"), QStringLiteral("Record:"), 0, 0, model->rowCount() - 1, 1, &ok);
+    if (!ok) { return; }
+
+    auto const index = model->index(row, 0);
+    view->setCurrentIndex(index);
+    view->scrollTo(index, QAbstractItemView::PositionAtTop);
+}
+
+
+// Destroys a model on a throwaway thread, so that the GUI goes on meanwhile.  The future is
+// ready once the model's memory has been released.
+std::shared_future<void> dispose_model(QAbstractItemModel* model)
+{
+    model->setParent(nullptr);
+
+    // A stream's socket cannot follow the model to another thread; close it here, quietly.
+    for (auto socket : model->findChildren<QLocalSocket*>())
+    {
+        socket->disconnect();
+        delete socket;
+    }
+
+    auto released = std::make_shared<std::promise<void>>();
+    std::shared_future<void> teardown = released->get_future();
+
+    auto reaper = new QThread;
+    model->moveToThread(reaper);
+
+    QObject::connect(reaper, &QThread::started, [=]
+    {
+        delete model;
+        released->set_value();
+        reaper->quit();
+    });
+    QObject::connect(reaper, &QThread::finished, reaper, &QObject::deleteLater);
+    reaper->start();
+
+    return teardown;
+}
+
+
+using msgscan::read_header;
+using msgscan::is_str;
+using msgscan::skip;
+
+
+// Node for the object at `p`, with its children yet to be fetched.  A truncated object has
+// children only if its own header is complete.
+static ItemModel::Node make_node(char const* p, char const* end, std::uint64_t offset, std::uint64_t length, std::uint32_t parent, bool truncated)
+{
+    auto const byte = static_cast<unsigned char>(*p);
+    msgscan::Header h;
+    auto const children = !read_header(p, end, h) ? 0 : static_cast<std::uint32_t>(is_str(byte) ? (h.payload != 0) : h.count);
+    return {offset, length, parent, ItemModel::unfetched, children, byte, ItemModel::NodeKind::object, truncated};
+}
+
+
+QModelIndex ItemModel::index(int row, int column, QModelIndex const& parent) const
+{
+    if (!hasIndex(row, column, parent)) { return {}; }
+
+    auto const i = parent.isValid()
+        ? node(parent).first_child + static_cast<std::uint32_t>(row)
+        : record_node(static_cast<std::size_t>(row));
+    return createIndex(row, column, quintptr{i});
+}
+
+QModelIndex ItemModel::parent(QModelIndex const& index) const
+{
+    if (!index.isValid()) { return {}; }
+
+    auto const p = node(index).parent;
+    if (p == no_parent) { return {}; }
+
+    return index_of(p);
+}
+
+// Index of nodes[i], which must be reachable from the records.
+QModelIndex ItemModel::index_of(std::uint32_t i) const
+{
+    auto const p = nodes[i].parent;
+    auto const row = p == no_parent
+        ? record_of(nodes[i].offset)
+        : i - nodes[p].first_child;
+    return createIndex(static_cast<int>(row), 0, quintptr{i});
+}
+
+int ItemModel::rowCount(QModelIndex const& parent) const
+{
+    if (!parent.isValid()) { return static_cast<int>(records.size()); }
+    if (parent.column() != 0) { return 0; }
+
+    auto const& n = node(parent);
+    return n.first_child == unfetched ? 0 : static_cast<int>(n.child_count);
+}
+
+int ItemModel::columnCount(QModelIndex const&) const
+{
+    return 2;
+}
+
+QVariant ItemModel::data(QModelIndex const& index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole)) { return {}; }
+
+    auto const& n = node(index);
+    if (role == Qt::ToolTipRole)
+    {
+        auto const e = n.kind == NodeKind::object ? find_extent(n.offset) : nullptr;
+        if (!e) { return {}; }
+        return QStringLiteral("%1 bytes, %2 nested objects").arg(e->end - e->offset).arg(e->elements);
+    }
+
+    switch (index.column())
+    {
+    case 0: return n.parent == no_parent ? QStringLiteral("#%1 %2").arg(evicted + static_cast<std::uint64_t>(index.row())).arg(label(n)) : label(n);
+    case 1: return QString::number(n.offset, 16);
+    }
+    return {};
+}
+
+Qt::ItemFlags ItemModel::flags(QModelIndex const& index) const
+{
+    if (!index.isValid()) { return Qt::NoItemFlags; }
+
+    auto const& n = node(index);
+    auto const leaf = n.kind == NodeKind::str_body || n.child_count == 0;
+    return leaf ? Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren
+                : Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+bool ItemModel::hasChildren(QModelIndex const& parent) const
+{
+    if (!parent.isValid()) { return !records.empty(); }
+    return parent.column() == 0 && node(parent).child_count != 0;
+}
+
+bool ItemModel::canFetchMore(QModelIndex const& parent) const
+{
+    if (!parent.isValid() || parent.column() != 0) { return false; }
+
+    auto const& n = node(parent);
+    return n.child_count != 0 && n.first_child == unfetched;
+}
+
+void ItemModel::fetchMore(QModelIndex const& parent)
+{
+    if (!canFetchMore(parent)) { return; }
+
+    // The number of rows is only known after decoding: a truncated container may have fewer
+    // children than it says.  The new nodes are not reachable before first_child is set.
+    auto const i = static_cast<std::uint32_t>(parent.internalId());
+    auto const first = static_cast<std::uint32_t>(nodes.size());
+    auto const count = decode_children(i);
+    if (count != 0) { beginInsertRows(parent, 0, static_cast<int>(count) - 1); }
+    nodes[i].first_child = first;
+    nodes[i].child_count = count;
+    if (count != 0) { endInsertRows(); }
+}
+
+// Collects the offset of every top-level object.  `progress` is as for construct_model.
+bool ItemModel::index_records(std::function<bool (qint64)> const& progress)
+{
+    char const* const begin = file->begin();
+    char const* const end = file->end();
+
+    if (structure.empty())
+    {
+        // Without the structure index every record has to be walked; do it on all cores.
+        auto truncated = false;
+        if (!msgscan::find_records(begin, end, built_records, truncated, std::thread::hardware_concurrency(), progress)) { return false; }
+        if (truncated) { truncation = built_records.back(); }
+    }
+    else
+    {
+        auto const report_step = std::max<std::ptrdiff_t>((end - begin) / 1000, 1 << 20);
+        auto report = begin + std::min(report_step, end - begin);
+
+        std::size_t extent = 0; // Extent of the first container at or after `p`.
+        for (auto p = begin; p < end; )
+        {
+            built_records.push_back(static_cast<std::uint64_t>(p - begin));
+            if (!skip_one(p, extent)) { truncation = built_records.back(); }
+
+            if (p >= report)
+            {
+                if (!progress(p - begin)) { return false; }
+                report = end - p > report_step ? p + report_step : end;
+            }
+        }
+    }
+
+    built_records.shrink_to_fit();
+    records = ArrayView<std::uint64_t>{built_records};
+    return true;
+}
+
+bool ItemModel::follow()
+{
+    auto grown = std::make_unique<MappedFile const>(file->filename());
+    if (!grown->is_open() || grown->size() < file->size()) { return false; }
+    if (grown->size() == file->size()) { return true; }
+
+    own_index();
+
+    // A truncated last record is decoded again, from its start, now that more of it is there.
+    auto from = static_cast<std::uint64_t>(file->size());
+    if (truncation != not_truncated)
+    {
+        from = truncation;
+
+        auto const row = built_records.size() - 1;
+        beginRemoveRows({}, static_cast<int>(row), static_cast<int>(row));
+        record_nodes.erase(row);
+        built_records.pop_back();
+        records = ArrayView<std::uint64_t>{built_records};
+        truncation = not_truncated;
+        endRemoveRows();
+
+        // Walks of its containers are for nodes no longer shown.
+        for (auto walker : findChildren<ElementWalker*>())
+        {
+            if (walker->first_offset() >= from) { delete walker; }
+        }
+
+        // Its extents are the last ones, being in file order.
+        auto const e = std::lower_bound(built_structure.begin(), built_structure.end(), from, [](msgscan::Extent const& e, std::uint64_t offset) { return e.offset < offset; });
+        built_structure.erase(e, built_structure.end());
+        structure = ArrayView<msgscan::Extent>{built_structure};
+    }
+
+    file = std::move(grown);
+    char const* const begin = file->begin();
+    char const* const end = file->end();
+
+    std::vector<std::uint64_t> appended;
+    auto p = begin + from;
+    if (structure.empty())
+    {
+        if (!msgscan::find_records(begin, p, end, end, appended)) { truncation = appended.back(); }
+    }
+    else
+    {
+        // Extend the structure index over the new bytes first, so that they are skipped in O(1)
+        // like the rest.
+        auto const first = built_structure.size();
+        msgscan::build_structure(p, end, built_structure, [](std::ptrdiff_t) { return true; });
+        for (auto i = first; i != built_structure.size(); ++i)
+        {
+            built_structure[i].offset += from;
+            built_structure[i].end += from;
+        }
+        structure = ArrayView<msgscan::Extent>{built_structure};
+
+        auto extent = first;
+        while (p < end)
+        {
+            appended.push_back(static_cast<std::uint64_t>(p - begin));
+            if (!skip_one(p, extent)) { truncation = appended.back(); }
+        }
+    }
+
+    if (appended.empty()) { return true; }
+
+    auto const row = static_cast<int>(built_records.size());
+    beginInsertRows({}, row, row + static_cast<int>(appended.size()) - 1);
+    built_records.insert(built_records.end(), appended.begin(), appended.end());
+    records = ArrayView<std::uint64_t>{built_records};
+    endInsertRows();
+    return true;
+}
+
+void ItemModel::append_stream(char const* data, std::size_t size)
+{
+    Q_ASSERT(is_stream() && truncation == not_truncated);
+
+    window.insert(window.end(), data, data + size);
+
+    std::vector<std::uint64_t> appended;
+    splitter.split(window.data(), window.data() + window.size(), [&](std::uint64_t start, std::uint64_t) { appended.push_back(start); });
+
+    if (!appended.empty())
+    {
+        auto const row = static_cast<int>(built_records.size());
+        beginInsertRows({}, row, row + static_cast<int>(appended.size()) - 1);
+        built_records.insert(built_records.end(), appended.begin(), appended.end());
+        records = ArrayView<std::uint64_t>{built_records};
+        endInsertRows();
+    }
+
+    if (window.size() <= window_capacity) { return; }
+
+    // Make room for a quarter of the window at once, so that its bytes are moved only every so
+    // often.  A record still coming in stays, however large.
+    auto const keep = window_capacity / 4 * 3;
+    auto const first = std::lower_bound(built_records.begin(), built_records.end(), window.size() - keep);
+    auto const count = static_cast<std::size_t>(first - built_records.begin());
+    if (count != 0) { evict(count, first != built_records.end() ? *first : splitter.unfinished()); }
+}
+
+void ItemModel::end_stream()
+{
+    Q_ASSERT(is_stream());
+
+    auto const rest = splitter.unfinished();
+    if (rest >= window.size() || truncation != not_truncated) { return; }
+
+    auto const row = static_cast<int>(built_records.size());
+    beginInsertRows({}, row, row);
+    built_records.push_back(rest);
+    records = ArrayView<std::uint64_t>{built_records};
+    truncation = rest;
+    endInsertRows();
+}
+
+// Drops the first `count` records of a stream, and the first `shift` bytes of the window that
+// they take.  Nodes are referred to by position, so the remaining ones are packed to the front
+// of the array and the indexes the view holds on to are moved along with them.
+void ItemModel::evict(std::size_t count, std::uint64_t shift)
+{
+    beginRemoveRows({}, 0, static_cast<int>(count) - 1);
+    built_records.erase(built_records.begin(), built_records.begin() + static_cast<std::ptrdiff_t>(count));
+    records = ArrayView<std::uint64_t>{built_records};
+    evicted += count;
+
+    decltype(record_nodes) kept;
+    record_nodes.for_each([&](std::size_t record, std::uint32_t node)
+    {
+        if (record >= count) { kept.emplace(record - count, node); }
+    });
+    record_nodes.swap(kept);
+    endRemoveRows();
+
+    emit layoutAboutToBeChanged();
+
+    // Records first, then the children of each node in turn, which keeps siblings together.
+    std::vector<std::uint32_t> moved(nodes.size(), std::uint32_t{no_node}); // Old position to new.
+    std::vector<Node> packed;
+    packed.reserve(record_nodes.size());
+    record_nodes.for_each([&](std::size_t, std::uint32_t& node)
+    {
+        moved[node] = static_cast<std::uint32_t>(packed.size());
+        packed.push_back(nodes[node]);
+        node = moved[node];
+    });
+    for (std::size_t i = 0; i != packed.size(); ++i)
+    {
+        packed[i].offset -= shift;
+
+        auto const children = packed[i].first_child;
+        if (children == unfetched) { continue; }
+
+        auto const first = static_cast<std::uint32_t>(packed.size());
+        packed[i].first_child = first;
+        for (std::uint32_t c = 0; c != packed[i].child_count; ++c)
+        {
+            moved[children + c] = first + c;
+            packed.push_back(nodes[children + c]);
+            packed.back().parent = static_cast<std::uint32_t>(i);
+        }
+    }
+    nodes.swap(packed);
+
+    auto const from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (auto const& index : from)
+    {
+        auto const i = moved[static_cast<std::size_t>(index.internalId())];
+        to.push_back(i == no_node ? QModelIndex{} : createIndex(index.row(), index.column(), quintptr{i}));
+    }
+    changePersistentIndexList(from, to);
+
+    window.erase(window.begin(), window.begin() + static_cast<std::ptrdiff_t>(shift));
+    for (auto& r : built_records) { r -= shift; }
+    splitter.rebase(shift);
+
+    emit layoutChanged();
+}
+
+QModelIndex ItemModel::locate(std::uint64_t offset)
+{
+    auto const record = std::upper_bound(records.begin(), records.end(), offset) - records.begin();
+    if (record == 0) { return {}; }
+
+    // Down through the last child starting at or before `offset` (ranges included), until the
+    // object itself.
+    auto index = this->index(static_cast<int>(record - 1), 0);
+    for (;;)
+    {
+        if (node(index).kind == NodeKind::object && node(index).offset == offset) { return index; }
+
+        if (canFetchMore(index)) { fetchMore(index); }
+        auto const rows = rowCount(index);
+        if (rows == 0) { return {}; }
+
+        auto const first = nodes.begin() + node(index).first_child;
+        auto const child = std::upper_bound(first, first + rows, offset, [](std::uint64_t offset, Node const& n) { return offset < n.offset; }) - first;
+        if (child == 0) { return {}; }
+
+        index = this->index(static_cast<int>(child - 1), 0, index);
+    }
+}
+
+// Moves the index off the sidecar mapping, if that is where it is, so that it can grow.
+void ItemModel::own_index()
+{
+    if (!sidecar) { return; }
+
+    built_records.assign(records.begin(), records.end());
+    built_structure.assign(structure.begin(), structure.end());
+    records = ArrayView<std::uint64_t>{built_records};
+    structure = ArrayView<msgscan::Extent>{built_structure};
+    sidecar.reset();
+}
+
+// Makes room for `more` nodes at once.  Room is made by doubling rather than for exactly that
+// many, so that expanding container after container reallocates the array O(log n) times
+// rather than every time.
+void ItemModel::reserve_nodes(std::uint64_t more) const
+{
+    auto const needed = nodes.size() + static_cast<std::size_t>(more);
+    if (needed > nodes.capacity()) { nodes.reserve(std::max(needed, nodes.capacity() * 2)); }
+}
+
+// Node of records[record], created on first use.
+std::uint32_t ItemModel::record_node(std::size_t record) const
+{
+    if (auto const found = record_nodes.find(record)) { return *found; }
+
+    char const* const begin = data_begin();
+    char const* const end = data_end();
+
+    auto const offset = records[record];
+    auto const next = record + 1 != records.size() ? records[record + 1] : records_end();
+    auto const truncated = offset == truncation;
+
+    auto const i = static_cast<std::uint32_t>(nodes.size());
+    nodes.push_back(make_node(begin + offset, end, offset, next - offset, no_parent, truncated));
+    record_nodes.emplace(record, i);
+    return i;
+}
+
+// End of the last record.  That of a stream is short of the window while a record is still
+// coming in.
+std::uint64_t ItemModel::records_end() const noexcept
+{
+    if (file) { return static_cast<std::uint64_t>(file->size()); }
+    return truncation != not_truncated ? static_cast<std::uint64_t>(window.size()) : splitter.unfinished();
+}
+
+// Number of the record starting at `offset`.
+std::size_t ItemModel::record_of(std::uint64_t offset) const
+{
+    return static_cast<std::size_t>(std::lower_bound(records.begin(), records.end(), offset) - records.begin());
+}
+
+// Elements in each range of a container or range with `count` elements: the smallest power of
+// page_size that makes for no more than page_size ranges.
+static std::uint64_t page_span(std::uint64_t count)
+{
+    auto span = ItemModel::page_size;
+    while ((count - 1) / span >= ItemModel::page_size) { span *= ItemModel::page_size; }
+    return span;
+}
+
+// Number of rows under a container or range with `count` elements.
+static std::uint32_t page_rows(std::uint64_t count)
+{
+    return static_cast<std::uint32_t>(count > ItemModel::page_size ? (count - 1) / page_span(count) + 1 : count);
+}
+
+// Walks the `count` elements at `p`, moving it past them, with `skip_element` (which moves `p`
+// past one and returns false if it is cut short), and reports the children they make through
+// child(offset, length, truncated): the elements themselves, `length` in bytes; or if there are
+// more than page_size, ranges of them, `length` in elements.  Stops at the end of the input, or
+// once `child` returns false, and returns false then.
+template <class Skip, class Child>
+static bool walk_children(char const* begin, char const*& p, char const* end, std::uint64_t count, Skip skip_element, Child child)
+{
+    if (count <= ItemModel::page_size)
+    {
+        for (std::uint64_t i = 0; i != count && p < end; ++i)
+        {
+            auto const start = p;
+            auto const whole = skip_element();
+            if (!child(static_cast<std::uint64_t>(start - begin), static_cast<std::uint64_t>(p - start), !whole)) { return false; }
+        }
+        return true;
+    }
+
+    // Only where each range starts is needed; nothing is decoded.
+    auto const span = page_span(count);
+    for (std::uint64_t i = 0; i < count && p < end; i += span)
+    {
+        auto const start = p;
+        auto const size = std::min(span, count - i);
+
+        std::uint64_t present = 0;
+        auto whole = true;
+        for (; present != size && p < end && whole; ++present)
+        {
+            whole = skip_element();
+        }
+
+        if (!child(static_cast<std::uint64_t>(start - begin), present, !whole || present != size)) { return false; }
+    }
+    return true;
+}
+
+// Appends the children of nodes[parent] and returns how many there are; fewer than its
+// child_count if the file ends early.  Leaves the parent itself alone.  A large container
+// of a file without the structure index gets a pending node instead, and an ElementWalker
+// to find its children, which adopt_children() puts in its place.
+std::uint32_t ItemModel::decode_children(std::uint32_t parent)
+{
+    char const* const begin = data_begin();
+    char const* const end = data_end();
+
+    auto const first = nodes.size();
+    auto const offset = nodes[parent].offset;
+    auto const type = nodes[parent].type;
+    reserve_nodes(page_rows(nodes[parent].child_count));
+
+    // Nodes with children have a complete header.
+    auto p = begin + offset;
+    std::uint64_t count;
+    if (nodes[parent].kind == NodeKind::range)
+    {
+        count = nodes[parent].length;
+    }
+    else
+    {
+        msgscan::Header h;
+        read_header(p, end, h);
+        if (is_str(type))
+        {
+            auto const truncated = nodes[parent].truncated;
+            auto const text = truncated ? StringPool::none : strings.intern(p + h.size, h.payload);
+            nodes.push_back(Node{offset, text, parent, unfetched, 0, type, NodeKind::str_body, truncated});
+            return 1;
+        }
+
+        count = h.count;
+        p += h.size + h.payload;
+    }
+
+    // Walking the elements would take as long as reading their bytes.
+    auto const indexed = !structure.empty();
+    if (!indexed && file && extent_bytes(parent) > background_bytes)
+    {
+        auto const at = static_cast<std::uint64_t>(p - begin);
+        nodes.push_back(Node{at, count, parent, unfetched, 0, type, NodeKind::pending, false});
+
+        auto const walker = new ElementWalker{file->filename(), static_cast<std::uint64_t>(file->size()), parent, at, count, this};
+        QObject::connect(walker, &QThread::finished, this, [this, walker]{ adopt_children(walker); });
+        walker->start();
+        return 1;
+    }
+
+    // The extent of the first container among the elements, if the structure was indexed.
+    auto extent = static_cast<std::size_t>(std::lower_bound(structure.begin(), structure.end(), static_cast<std::uint64_t>(p - begin), [](msgscan::Extent const& e, std::uint64_t offset) { return e.offset < offset; }) - structure.begin());
+    auto const skip_element = [&]
+    {
+        return indexed ? skip_one(p, extent) : skip(p, end, 1) == 0;
+    };
+
+    walk_children(begin, p, end, count, skip_element, [&](std::uint64_t at, std::uint64_t length, bool truncated)
+    {
+        nodes.push_back(count <= page_size
+            ? make_node(begin + at, end, at, length, parent, truncated)
+            : Node{at, length, parent, unfetched, page_rows(length), type, NodeKind::range, truncated});
+        return true;
+    });
+    return static_cast<std::uint32_t>(nodes.size() - first);
+}
+
+// Replaces the pending node under the container `walker` was walking with the children it
+// found: the pending row is removed, then the children are inserted.
+void ItemModel::adopt_children(ElementWalker* walker)
+{
+    walker->deleteLater();
+
+    auto const parent = walker->parent_node();
+    auto const type = nodes[parent].type;
+    auto const pending = nodes[parent].first_child;
+    auto const count = nodes[pending].length;
+    auto const children = walker->take_children();
+
+    char const* const end = data_end();
+    reserve_nodes(children.size());
+    auto const first = static_cast<std::uint32_t>(nodes.size());
+    for (auto const& c : children)
+    {
+        nodes.push_back(count <= page_size
+            ? make_node(data_begin() + c.offset, end, c.offset, c.length, parent, c.truncated)
+            : Node{c.offset, c.length, parent, unfetched, page_rows(c.length), type, NodeKind::range, c.truncated});
+    }
+
+    // The new nodes are not reachable before first_child is set.
+    auto const index = index_of(parent);
+    beginRemoveRows(index, 0, 0);
+    nodes[parent].child_count = 0;
+    endRemoveRows();
+
+    if (children.empty()) { return; }
+
+    beginInsertRows(index, 0, static_cast<int>(children.size()) - 1);
+    nodes[parent].first_child = first;
+    nodes[parent].child_count = static_cast<std::uint32_t>(children.size());
+    endInsertRows();
+
+    emit adopted(index);
+}
+
+// Encoded size of a container or range, in bytes.  That of a range runs up to the next one, or
+// to the end of its parent.
+std::uint64_t ItemModel::extent_bytes(std::uint32_t i) const
+{
+    if (nodes[i].kind != NodeKind::range) { return nodes[i].length; }
+
+    auto const parent = nodes[i].parent;
+    auto const last = nodes[parent].first_child + nodes[parent].child_count - 1;
+    auto const end = i != last ? nodes[i + 1].offset : nodes[parent].offset + extent_bytes(parent);
+    return end - nodes[i].offset;
+}
+
+// Number of the first element of a range within its container.  All but the last of the
+// ranges under the same parent are the same size.
+std::uint64_t ItemModel::first_element(Node const& range) const
+{
+    std::uint64_t first = 0;
+    for (auto i = static_cast<std::uint32_t>(&range - nodes.data()); nodes[i].kind == NodeKind::range; i = nodes[i].parent)
+    {
+        auto const siblings = nodes[nodes[i].parent].first_child;
+        first += (i - siblings) * nodes[siblings].length;
+    }
+    return first;
+}
+
+// Moves `p` past the object there, whose extent, if it is a container, is structure[extent];
+// in O(1) and without touching the container's body.  Advances `extent` past the object.
+// Returns false if the object is cut short by the end of the file, leaving `p` there.
+bool ItemModel::skip_one(char const*& p, std::size_t& extent) const
+{
+    char const* const end = data_end();
+
+    msgscan::Header h;
+    if (!read_header(p, end, h) || !msgscan::fits(h, p, end))
+    {
+        p = end;
+        return false;
+    }
+
+    if (h.count == 0)
+    {
+        p += h.size + h.payload;
+        return true;
+    }
+
+    auto const& e = structure[extent];
+    Q_ASSERT(e.offset == static_cast<std::uint64_t>(p - data_begin()));
+    extent += 1 + e.containers;
+    p = data_begin() + e.end;
+    return !e.truncated;
+}
+
+msgscan::Extent const* ItemModel::find_extent(std::uint64_t offset) const
+{
+    return msgscan::find_extent(structure.begin(), structure.end(), offset);
+}
+
+QVariant ItemModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
+    {
+        static const QVariant v_data{QStringLiteral("Data (Type/Value/...)")};
+        static const QVariant v_offset{QStringLiteral("Offset in HEX (Byte)")};
+
+        switch (section)
+        {
+        case 0: return v_data;
+        case 1: return v_offset;
+        }
+    }
+    return super::headerData(section, orientation, role);
+}
+
+// Formats the label of a single object.  Whether a str is UTF-8 is kept in `utf8`, so that
+// its text is only checked once.
+struct LabelVisitor final : msgscan::BasicVisitor
+{
+    using Token = msgscan::Token;
+    using Utf8 = ItemModel::Utf8;
+
+    explicit LabelVisitor(Utf8& utf8) : utf8(utf8) { }
+
+    void on_nil(Token t) { label = name(t); }
+    void on_never_used(Token t) { label = name(t); }
+    void on_bool(Token t, bool) { label = name(t); }
+    void on_uint(Token t, std::uint64_t value) { label = QStringLiteral("%1: %2").arg(name(t)).arg(value); }
+    void on_int(Token t, std::int64_t value) { label = QStringLiteral("%1: %2").arg(name(t)).arg(value); }
+    void on_float(Token t, double value) { label = QStringLiteral("%1: %2").arg(name(t)).arg(value); }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        label = length ? QStringLiteral("%1: length %2").arg(name(t)).arg(length) : QStringLiteral("%1: empty").arg(name(t));
+        if (utf8 == Utf8::unknown) { utf8 = msgscan::valid_utf8(data, length) ? Utf8::valid : Utf8::invalid; }
+        if (utf8 == Utf8::invalid) { label += QStringLiteral(" (invalid UTF-8)"); }
+    }
+
+    void on_bin(Token t, char const*, std::uint32_t length)
+    {
+        label = QStringLiteral("%1: length %2").arg(name(t)).arg(length);
+    }
+
+    void on_ext(Token t, std::int8_t type, char const*, std::uint32_t length)
+    {
+        label = 0xd4u <= t.type && t.type <= 0xd8u
+            ? QStringLiteral("%1: type %2").arg(name(t)).arg(type)
+            : QStringLiteral("%1: type %2 length %3").arg(name(t)).arg(type).arg(length);
+    }
+
+    bool begin_array(Token t, std::uint32_t count) { return container(t, count); }
+    bool begin_map(Token t, std::uint32_t count) { return container(t, count); }
+
+    void on_truncated(Token t)
+    {
+        label = QStringLiteral("%1: truncated").arg(name(t));
+        truncated = true;
+    }
+
+    QString label;
+    bool truncated = false;
+
+private:
+    static QString name(Token t) { return QString::fromLatin1(msgscan::type_name(t.type)); }
+
+    bool container(Token t, std::uint32_t count)
+    {
+        label = count ? QStringLiteral("%1: count %2").arg(name(t)).arg(count) : QStringLiteral("%1: empty").arg(name(t));
+        return false;
+    }
+
+    Utf8& utf8;
+};
+
+// Text of a str body as shown in its row.  A long one is cut short at a character boundary,
+// so that painting the row does not take time in proportion to the str.
+static QString body_text(char const* data, std::uint64_t length, std::uint64_t max_body = 4096)
+{
+    if (length <= max_body) { return QString::fromUtf8(data, static_cast<int>(length)); }
+
+    // Back up over at most three continuation bytes to the start of a character.
+    auto cut = max_body;
+    while (cut > max_body - 3 && (static_cast<unsigned char>(data[cut]) & 0xc0u) == 0x80u) { --cut; }
+    return QStringLiteral("%1... (%2 bytes)").arg(QString::fromUtf8(data, static_cast<int>(cut))).arg(length);
+}
+
+QString ItemModel::label(Node const& node) const
+{
+    if (node.kind == NodeKind::pending)
+    {
+        return QStringLiteral("Walking %1 elements...").arg(node.length);
+    }
+
+    if (node.kind == NodeKind::range)
+    {
+        auto const first = first_element(node);
+        auto const label = QStringLiteral("[%1..%2]").arg(first).arg(first + node.length - 1);
+        return node.truncated ? label + QStringLiteral(" (truncated)") : label;
+    }
+
+    // Decoded once, rather than again on every repaint.
+    if (node.kind == NodeKind::str_body && node.length != StringPool::none)
+    {
+        return strings.text(static_cast<std::uint32_t>(node.length));
+    }
+
+    char const* const p = data_begin() + node.offset;
+    char const* const end = data_end();
+
+    if (node.kind == NodeKind::str_body)
+    {
+        // Whatever part of the text is there.
+        msgscan::Header h;
+        read_header(p, end, h);
+        auto const length = std::min<std::uint64_t>(h.payload, static_cast<std::uint64_t>(end - p) - h.size);
+        return body_text(p + h.size, length);
+    }
+
+    LabelVisitor visitor{node.utf8};
+    msgscan::visit(p, end, node.offset, visitor);
+
+    // A container missing elements still has a complete header of its own.
+    if (node.truncated && !visitor.truncated)
+    {
+        visitor.label += QStringLiteral(" (truncated)");
+    }
+    return visitor.label;
+}
+
+
+Follower::Follower(ItemModel* model, QTreeView* view, QStatusBar* status)
+  : super{view}, model{model}, view{view}, status{status}, watcher{QStringList{model->filename()}}
+{
+    timer.setSingleShot(true);
+    timer.setInterval(interval);
+
+    QObject::connect(&watcher, &QFileSystemWatcher::fileChanged, this, [this]
+    {
+        if (!timer.isActive()) { timer.start(); }
+    });
+    QObject::connect(&timer, &QTimer::timeout, this, [this]{ update(); });
+
+    // Whatever was appended between loading and now.
+    update();
+}
+
+void Follower::update()
+{
+    // Keep the newest records in sight, unless the user has scrolled away from them.
+    auto const bar = view->verticalScrollBar();
+    auto const at_bottom = bar->value() == bar->maximum();
+
+    if (!model->follow())
+    {
+        status->showMessage(QStringLiteral("Stopped following: the file shrank or cannot be read"));
+        deleteLater();
+        return;
+    }
+
+    // Offsets may have gained a digit.
+    fit_columns(view, model->max_offset());
+
+    if (at_bottom) { view->scrollToBottom(); }
+}
+
+
+void StdinReader::run()
+{
+    for (;;)
+    {
+        available.acquire();
+        if (isInterruptionRequested()) { return; }
+
+        QByteArray chunk{chunk_size, Qt::Uninitialized};
+#ifdef Q_OS_WIN
+        auto const n = _read(0, chunk.data(), chunk_size);
+#else
+        auto const n = ::read(0, chunk.data(), chunk_size);
+#endif
+        if (n <= 0) { return; }
+
+        chunk.resize(static_cast<int>(n));
+        emit received(chunk);
+    }
+}
+
+
+Searcher::~Searcher()
+{
+    requestInterruption();
+    wait();
+}
+
+void Searcher::run()
+{
+    MappedFile const file{filename};
+    if (!file.is_open() || static_cast<std::uint64_t>(file.size()) < size) { return; }
+
+    // The path and value of each match, for as many as are listed.  The matches in a record
+    // are described in one walk over it.
+    std::size_t listed = 0;
+    auto const describe = [&](std::vector<std::uint64_t> const& hits)
+    {
+        QVector<quint64> offsets;
+        QStringList paths;
+        QStringList values;
+        auto const last = hits.begin() + static_cast<std::ptrdiff_t>(std::min(hits.size(), max_described - listed));
+        for (auto hit = hits.begin(); hit != last; )
+        {
+            auto const record = std::upper_bound(records.begin(), records.end(), *hit);
+            if (record == records.begin()) { ++hit; continue; }
+
+            auto const begin = record[-1];
+            auto const end = record == records.end() ? size : *record;
+            auto const next = std::lower_bound(hit, last, end);
+            msgscan::find_paths(file.begin() + begin, file.begin() + end, begin, &*hit, &*hit + (next - hit), [&](std::uint64_t offset, std::string const& path)
+            {
+                auto const p = file.begin() + offset;
+                QString value;
+                msgscan::Header h;
+                if (msgscan::descriptor(static_cast<unsigned char>(*p)).kind == msgscan::Kind::str && read_header(p, file.begin() + end, h) && msgscan::fits(h, p, file.begin() + end))
+                {
+                    value = body_text(p + h.size, h.payload, 256);
+                }
+                else
+                {
+                    auto utf8 = ItemModel::Utf8::unknown;
+                    LabelVisitor visitor{utf8};
+                    msgscan::visit(p, file.begin() + end, offset, visitor);
+                    value = visitor.label;
+                }
+                offsets.push_back(offset);
+                paths << QString::fromStdString(path);
+                values << value;
+            });
+            hit = next;
+        }
+        listed += static_cast<std::size_t>(offsets.size());
+        if (!offsets.isEmpty()) { emit described(offsets, paths, values); }
+    };
+
+    auto const report = [&](std::vector<std::uint64_t> const& hits, std::uint64_t consumed)
+    {
+        if (!hits.empty())
+        {
+            QVector<quint64> batch;
+            batch.reserve(static_cast<int>(hits.size()));
+            for (auto const offset : hits) { batch.push_back(offset); }
+            emit found(batch);
+
+            if (by_path && listed < max_described) { describe(hits); }
+        }
+        emit progressed(static_cast<qint64>(consumed), static_cast<qint64>(size));
+        return !isInterruptionRequested();
+    };
+
+    auto const workers = std::thread::hardware_concurrency();
+    if (by_path)
+    {
+        msgscan::search(file.begin(), file.begin() + size, records.data(), records.size(), path, workers, report);
+    }
+    else
+    {
+        msgscan::search(file.begin(), file.begin() + size, records.data(), records.size(), query, workers, report);
+    }
+}
+
+
+SchemaBuilder::~SchemaBuilder()
+{
+    requestInterruption();
+    wait();
+}
+
+void SchemaBuilder::run()
+{
+    MappedFile const file{filename};
+    if (!file.is_open() || static_cast<std::uint64_t>(file.size()) < size) { return; }
+
+    auto result = std::make_unique<msgscan::Schema>();
+    auto const done = msgscan::infer_schema(file.begin(), file.begin() + size, records.data(), records.size(), std::thread::hardware_concurrency(), *result, [&](std::uint64_t consumed)
+    {
+        emit progressed(static_cast<qint64>(consumed), static_cast<qint64>(size));
+        return !isInterruptionRequested();
+    });
+    if (done) { schema = std::move(result); }
+}
+
+
+Search::Search(ItemModel* model, QTreeView* view, QStatusBar* status, Searcher* searcher)
+  : super{view}, model{model}, view{view}, status{status}, searcher{searcher}
+{
+    searcher->setParent(this);
+
+    QObject::connect(searcher, &Searcher::found, this, [this](QVector<quint64> const& batch)
+    {
+        auto const first = hits.empty();
+        hits.insert(hits.end(), batch.begin(), batch.end());
+        if (first) { select(0); }
+    });
+    QObject::connect(searcher, &Searcher::progressed, this, [this](qint64 consumed, qint64 total)
+    {
+        this->consumed = consumed;
+        this->total = total;
+        report();
+    });
+    QObject::connect(searcher, &QThread::finished, this, [this]
+    {
+        finished = true;
+        report();
+    });
+
+    searcher->start();
+}
+
+void Search::step(bool forward)
+{
+    if (hits.empty()) { return; }
+    select(forward ? (current + 1) % hits.size() : (current + hits.size() - 1) % hits.size());
+}
+
+void Search::select(std::size_t hit)
+{
+    current = hit;
+    report();
+
+    auto const index = model->locate(hits[hit]);
+    if (!index.isValid()) { return; }
+
+    view->setCurrentIndex(index);
+    view->scrollTo(index, QAbstractItemView::PositionAtCenter);
+}
+
+void Search::report()
+{
+    auto message = hits.empty()
+        ? QStringLiteral("No matches")
+        : QStringLiteral("Match %1 of %2").arg(current + 1).arg(hits.size());
+    if (!finished)
+    {
+        message += QStringLiteral(" so far (%1% searched)").arg(total ? consumed * 100 / total : 0);
+    }
+    status->showMessage(message);
+}
+
+
+Loader::~Loader()
+{
+    requestInterruption();
+    wait();
+}
+
+
+ElementWalker::~ElementWalker()
+{
+    requestInterruption();
+    wait();
+}
+
+void ElementWalker::run()
+{
+    MappedFile const file{filename};
+    if (!file.is_open() || static_cast<std::uint64_t>(file.size()) < size) { return; }
+
+    char const* const begin = file.begin();
+    char const* const end = begin + size;
+    auto p = begin + first;
+    walk_children(begin, p, end, count, [&]{ return skip(p, end, 1) == 0; }, [&](std::uint64_t at, std::uint64_t length, bool truncated)
+    {
+        children.push_back(Child{at, length, truncated});
+        return !isInterruptionRequested();
+    });
+}
+
+
+void Loader::run()
+{
+    auto file = std::make_unique<MappedFile const>(filename);
+    if (!file->is_open()) { return; }
+
+    auto const total = file->size();
+
+    std::unique_ptr<ItemModel> construct_model(std::unique_ptr<MappedFile const> file, bool index_structure, std::function<bool (qint64)> const& progress);
+    auto result = construct_model(std::move(file), index_structure, [&](qint64 consumed)
+    {
+        emit progressed(consumed, total);
+        return !isInterruptionRequested();
+    });
+    if (!result) { return; }
+
+    // Nodes and strings are allocated as the view decodes rows, which it only does once the
+    // model is handed over; without this, they could be while the previous model is still in
+    // memory.  Freeing a model is a matter of a few large arrays and at most
+    // StringPool::max_strings short texts, so it is usually over by now.
+    if (teardown.valid()) { teardown.wait(); }
+
+    // Hand the model over to the GUI thread, which is where the view will use it.
+    result->moveToThread(QCoreApplication::instance()->thread());
+    model = std::move(result);
+}
+
+
+// Collects the offset of every top-level object (record); records are decoded as the view
+// needs them.  With `index_structure`, the extent of every container is recorded first, so
+// that skipping one later never has to walk its body.
+// Both are saved to a sidecar index, which later opens of the unchanged file map instead.
+// `progress` is called with the number of bytes consumed so far, roughly every thousandth of
+// the input; returning false cancels decoding and yields nullptr.
+std::unique_ptr<ItemModel> construct_model(std::unique_ptr<MappedFile const> file, bool index_structure, std::function<bool (qint64)> const& progress)
+{
+    auto model = std::make_unique<ItemModel>(std::move(file));
+
+    auto& m = *model;
+
+    FileIndex saved;
+    if (auto sidecar = open_index(*m.file, saved))
+    {
+        // An index without structure will not do if structure was asked for.
+        if (saved.has_structure || !index_structure)
+        {
+            m.records = saved.records;
+            m.structure = saved.structure;
+            m.truncation = saved.truncation;
+            m.sidecar = std::move(sidecar);
+
+            // What is on disk is already up to date; it is not written again.
+            progress(m.file->size());
+            return model;
+        }
+    }
+
+    if (index_structure)
+    {
+        if (!msgscan::build_structure(m.file->begin(), m.file->end(), m.built_structure, progress)) { return nullptr; }
+        m.structure = ArrayView<msgscan::Extent>{m.built_structure};
+    }
+
+    if (!m.index_records(progress)) { return nullptr; }
+
+    save_index(*m.file, FileIndex{m.records, m.structure, m.truncation, index_structure});
+
+    progress(model->file->size());
+    return model;
+}
+
+
+#include "main.moc"
@@ -0,0 +1,50 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGVIEWER_MAPPED_FILE_HPP
+#define MSGVIEWER_MAPPED_FILE_HPP
+
+#include <QtGlobal>
+#include <QString>
+#include <QFile>
+
+
+// Read-only mapping of a whole file.  The decoder walks the mapped bytes in place, so the OS
+// pages in only what is actually touched instead of copying the entire file up front.
+class MappedFile final
+{
+public:
+    explicit MappedFile(QString const& filename);
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool is_open() const noexcept { return opened; }
+
+    char const* begin() const noexcept { return reinterpret_cast<char const*>(ptr); }
+    char const* end() const noexcept { return begin() + len; }
+    qint64 size() const noexcept { return len; }
+    QString filename() const { return file.fileName(); }
+
+private:
+    QFile file;
+    uchar* ptr = nullptr;
+    qint64 len = 0;
+    bool opened = false;
+};
+
+
+inline MappedFile::MappedFile(QString const& filename) : file{filename}
+{
+    if (!file.open(QFile::ReadOnly)) { return; }
+
+    len = file.size();
+    if (len == 0) { opened = true; return; } // Nothing to map, but still a valid (empty) input.
+
+    ptr = file.map(0, len);
+    opened = ptr != nullptr;
+}
+
+#endif // MSGVIEWER_MAPPED_FILE_HPP
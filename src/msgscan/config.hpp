@@ -0,0 +1,96 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_CONFIG_HPP
+#define MSGSCAN_CONFIG_HPP
+
+#include <cstdint>
+
+
+#ifdef __GNUC__
+#   define MSGSCAN_GNUC_VERSION (((__GNUC__ * 100) + __GNUC_MINOR__) * 100 + __GNUC_PATCHLEVEL__)
+#else
+#   define MSGSCAN_GNUC_VERSION 0
+#endif
+
+
+#ifndef __has_attribute
+#   define __has_attribute(...) 0
+#endif // !__has_attribute
+
+#ifndef __has_builtin
+#   define __has_builtin(...) 0
+#endif // !__has_builtin
+
+
+#if __has_attribute(__always_inline__)
+#   define MSGSCAN_FORCEINLINE inline __attribute__((__always_inline__))
+#elif defined(_MSC_VER)
+#   define MSGSCAN_FORCEINLINE __forceinline
+#else
+#   define MSGSCAN_FORCEINLINE inline
+#endif // MSGSCAN_FORCEINLINE
+
+
+#if __has_attribute(noreturn)
+#   define MSGSCAN_NORETURN [[noreturn]]
+#elif defined(_MSC_VER)
+#   define MSGSCAN_NORETURN __declspec(noreturn)
+#else
+#   define MSGSCAN_NORETURN
+#endif
+
+
+// SSE2 is part of x86-64, so it is used whenever it is enabled.  AVX2 kernels are compiled
+// for GCC and Clang regardless of the target flags, and chosen at run time.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define MSGSCAN_SSE2 1
+#else
+#   define MSGSCAN_SSE2 0
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && __has_attribute(__target__)
+#   define MSGSCAN_AVX2 1
+#   define MSGSCAN_TARGET_AVX2 __attribute__((__target__("avx2")))
+#else
+#   define MSGSCAN_AVX2 0
+#endif
+
+
+inline namespace builtins
+{
+
+#if !(__has_builtin(__builtin_unreachable) || (40500 <= MSGSCAN_GNUC_VERSION))
+MSGSCAN_NORETURN inline void __builtin_unreachable() {}
+#endif // !__builtin_unreachable
+
+
+#if !(__has_builtin(__builtin_bswap16) || (40800 <= MSGSCAN_GNUC_VERSION))
+MSGSCAN_FORCEINLINE std::uint16_t __builtin_bswap16(std::uint16_t x)
+{
+    return (static_cast<std::uint16_t>(                  static_cast<std::uint8_t>(x      )) << 8u)
+         | (static_cast<std::uint16_t>(                  static_cast<std::uint8_t>(x >> 8u))      );
+}
+#endif // !__builtin_bswap16
+
+#if !(__has_builtin(__builtin_bswap32) || (40300 <= MSGSCAN_GNUC_VERSION))
+MSGSCAN_FORCEINLINE std::uint32_t __builtin_bswap32(std::uint32_t x)
+{
+    return (static_cast<std::uint32_t>(__builtin_bswap16(static_cast<std::uint16_t>(x       ))) << 16u)
+         | (static_cast<std::uint32_t>(__builtin_bswap16(static_cast<std::uint16_t>(x >> 16u)))       );
+}
+#endif // !__builtin_bswap32
+
+#if !(__has_builtin(__builtin_bswap64) || (40300 <= MSGSCAN_GNUC_VERSION))
+MSGSCAN_FORCEINLINE std::uint64_t __builtin_bswap64(std::uint64_t x)
+{
+    return (static_cast<std::uint64_t>(__builtin_bswap32(static_cast<std::uint32_t>(x       ))) << 32u)
+         | (static_cast<std::uint64_t>(__builtin_bswap32(static_cast<std::uint32_t>(x >> 32u)))       );
+}
+#endif // !__builtin_bswap64
+
+} // namespace builtins
+
+#endif // MSGSCAN_CONFIG_HPP
@@ -0,0 +1,270 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_FORMAT_HPP
+#define MSGSCAN_FORMAT_HPP
+
+#include <cstdint>
+
+#include "msgscan/config.hpp"
+
+
+namespace msgscan
+{
+
+MSGSCAN_FORCEINLINE std::uint16_t loadbe16(void const* ptr)
+{
+    return __builtin_bswap16(*reinterpret_cast<std::uint16_t const*>(ptr));
+}
+MSGSCAN_FORCEINLINE std::uint32_t loadbe32(void const* ptr)
+{
+    return __builtin_bswap32(*reinterpret_cast<std::uint32_t const*>(ptr));
+}
+MSGSCAN_FORCEINLINE std::uint64_t loadbe64(void const* ptr)
+{
+    return __builtin_bswap64(*reinterpret_cast<std::uint64_t const*>(ptr));
+}
+
+
+// Layout of an encoded object: `size` header bytes (type byte included), `payload` bytes of
+// raw data (str/bin/ext/float/int bodies), then `count` nested objects (two per map entry).
+struct Header
+{
+    std::uint32_t size;
+    std::uint64_t payload;
+    std::uint64_t count;
+};
+
+
+enum class Kind : std::uint8_t
+{
+    nil,
+    never_used,
+    boolean, // The value is the low bit of the type byte.
+    positive_fixint,
+    negative_fixint,
+    uint,
+    int_,
+    float32,
+    float64,
+    str,
+    bin,
+    ext,     // The ext type is the last header byte.
+    array,
+    map,
+};
+
+// What a type byte says about the object it starts.  The payload length (or element count for
+// arrays and maps) is either `fixed`, or read from the `width` bytes after the type byte.
+struct Descriptor
+{
+    Kind kind;
+    std::uint8_t size;  // Header bytes, type byte included.
+    std::uint8_t width; // 0, 1, 2 or 4.
+    std::uint8_t fixed;
+    std::uint8_t arity; // Nested objects per element: 1 for arrays, 2 for maps, else 0.
+};
+
+constexpr Descriptor describe(unsigned byte)
+{
+    if (byte <= 0x7fu) { return {Kind::positive_fixint, 1, 0, 0, 0}; }
+    if (byte <= 0x8fu) { return {Kind::map, 1, 0, static_cast<std::uint8_t>(byte - 0x80u), 2}; }
+    if (byte <= 0x9fu) { return {Kind::array, 1, 0, static_cast<std::uint8_t>(byte - 0x90u), 1}; }
+    if (byte <= 0xbfu) { return {Kind::str, 1, 0, static_cast<std::uint8_t>(byte - 0xa0u), 0}; }
+    if (byte >= 0xe0u) { return {Kind::negative_fixint, 1, 0, 0, 0}; }
+
+    switch (byte)
+    {
+    case 0xc0u: return {Kind::nil, 1, 0, 0, 0};
+    case 0xc1u: return {Kind::never_used, 1, 0, 0, 0};
+    case 0xc2u: return {Kind::boolean, 1, 0, 0, 0};
+    case 0xc3u: return {Kind::boolean, 1, 0, 0, 0};
+    case 0xc4u: return {Kind::bin, 2, 1, 0, 0};
+    case 0xc5u: return {Kind::bin, 3, 2, 0, 0};
+    case 0xc6u: return {Kind::bin, 5, 4, 0, 0};
+    case 0xc7u: return {Kind::ext, 3, 1, 0, 0};
+    case 0xc8u: return {Kind::ext, 4, 2, 0, 0};
+    case 0xc9u: return {Kind::ext, 6, 4, 0, 0};
+    case 0xcau: return {Kind::float32, 1, 0, 4, 0};
+    case 0xcbu: return {Kind::float64, 1, 0, 8, 0};
+    case 0xccu: return {Kind::uint, 1, 0, 1, 0};
+    case 0xcdu: return {Kind::uint, 1, 0, 2, 0};
+    case 0xceu: return {Kind::uint, 1, 0, 4, 0};
+    case 0xcfu: return {Kind::uint, 1, 0, 8, 0};
+    case 0xd0u: return {Kind::int_, 1, 0, 1, 0};
+    case 0xd1u: return {Kind::int_, 1, 0, 2, 0};
+    case 0xd2u: return {Kind::int_, 1, 0, 4, 0};
+    case 0xd3u: return {Kind::int_, 1, 0, 8, 0};
+    case 0xd4u: return {Kind::ext, 2, 0, 1, 0};
+    case 0xd5u: return {Kind::ext, 2, 0, 2, 0};
+    case 0xd6u: return {Kind::ext, 2, 0, 4, 0};
+    case 0xd7u: return {Kind::ext, 2, 0, 8, 0};
+    case 0xd8u: return {Kind::ext, 2, 0, 16, 0};
+    case 0xd9u: return {Kind::str, 2, 1, 0, 0};
+    case 0xdau: return {Kind::str, 3, 2, 0, 0};
+    case 0xdbu: return {Kind::str, 5, 4, 0, 0};
+    case 0xdcu: return {Kind::array, 3, 2, 0, 1};
+    case 0xddu: return {Kind::array, 5, 4, 0, 1};
+    case 0xdeu: return {Kind::map, 3, 2, 0, 2};
+    default:    return {Kind::map, 5, 4, 0, 2}; // 0xdf
+    }
+}
+
+struct DescriptorTable
+{
+    Descriptor entries[256];
+};
+
+constexpr DescriptorTable make_descriptor_table()
+{
+    DescriptorTable table{};
+    for (unsigned byte = 0; byte != 256; ++byte)
+    {
+        table.entries[byte] = describe(byte);
+    }
+    return table;
+}
+
+// Holder for the table, so that a header-only library has a single definition of it.
+template <class = void>
+struct Descriptors
+{
+    static constexpr DescriptorTable table = make_descriptor_table();
+};
+
+template <class T>
+constexpr DescriptorTable Descriptors<T>::table;
+
+MSGSCAN_FORCEINLINE Descriptor const& descriptor(unsigned char byte)
+{
+    return Descriptors<>::table.entries[byte];
+}
+
+
+// No header takes more than this many bytes, so with at least that much input left from the
+// type byte a header is read unchecked and only its payload is compared against the end.
+// Decoding loops take the fully checked path only near the end of the input.
+constexpr std::ptrdiff_t unchecked_margin = 17;
+
+
+// The length field of `d` (or its fixed length) for the object at `p`.  Touches no byte past
+// the header.
+MSGSCAN_FORCEINLINE std::uint64_t read_length(Descriptor const& d, char const* p)
+{
+    switch (d.width)
+    {
+    case 0: return d.fixed;
+    case 1: return *reinterpret_cast<std::uint8_t const*>(p + 1);
+    case 2: return loadbe16(p + 1);
+    default: return loadbe32(p + 1);
+    }
+}
+
+MSGSCAN_FORCEINLINE Header make_header(Descriptor const& d, std::uint64_t length)
+{
+    // Without branching on the kind: the length is either the payload or the element count.
+    auto const scalar = std::uint64_t{0} - (d.arity == 0);
+    return {d.size, length & scalar, length * d.arity};
+}
+
+// Unchecked: the whole header must be readable from `p`.
+MSGSCAN_FORCEINLINE Header read_header(Descriptor const& d, char const* p)
+{
+    return make_header(d, read_length(d, p));
+}
+
+MSGSCAN_FORCEINLINE Header read_header(char const* p)
+{
+    return read_header(descriptor(static_cast<unsigned char>(*p)), p);
+}
+
+// Header of the object at `p`, read without touching anything at or past `end`.  Returns false
+// if the header itself is cut short; whether the payload fits is left to fits().
+MSGSCAN_FORCEINLINE bool read_header(char const* p, char const* const end, Header& h)
+{
+    if (end - p >= unchecked_margin)
+    {
+        h = read_header(p);
+        return true;
+    }
+
+    if (p >= end) { return false; }
+
+    auto const& d = descriptor(static_cast<unsigned char>(*p));
+    if (end - p < d.size) { return false; }
+
+    h = make_header(d, read_length(d, p));
+    return true;
+}
+
+// Whether the header and payload of the object at `p` end at or before `end`.
+MSGSCAN_FORCEINLINE bool fits(Header const& h, char const* p, char const* const end)
+{
+    return h.payload <= static_cast<std::uint64_t>(end - p) - h.size;
+}
+
+inline bool is_str(unsigned char byte)
+{
+    return descriptor(byte).kind == Kind::str;
+}
+
+inline bool is_map(unsigned char byte)
+{
+    return descriptor(byte).kind == Kind::map;
+}
+
+// Name of the format family of a type byte, as in the MessagePack specification.
+inline char const* type_name(unsigned char byte)
+{
+    if (byte <= 0x7fu) { return "positive fixint"; }
+    if (byte <= 0x8fu) { return "fixmap"; }
+    if (byte <= 0x9fu) { return "fixarray"; }
+    if (byte <= 0xbfu) { return "fixstr"; }
+    if (byte >= 0xe0u) { return "negative fixint"; }
+
+    static char const* const names[] =
+    {
+        "nil", "(never used)", "false", "true",
+        "bin 8", "bin 16", "bin 32",
+        "ext 8", "ext 16", "ext 32",
+        "float32", "float64",
+        "uint8", "uint16", "uint32", "uint64",
+        "int8", "int16", "int32", "int64",
+        "fixext 1", "fixext 2", "fixext 4", "fixext 8", "fixext 16",
+        "str 8", "str 16", "str 32",
+        "array 16", "array 32",
+        "map 16", "map 32",
+    };
+    return names[byte - 0xc0u];
+}
+
+// Skips over `n` consecutive objects starting at `p`, without decoding anything but headers.
+// Stops early once `p` reaches `limit`; returns the number of objects still to be skipped.
+// An object cut short by `end` leaves `p` at `end` with a non-zero result.
+inline std::uint64_t skip(char const*& p, char const* const end, std::uint64_t n, char const* const limit)
+{
+    while (n && p < limit)
+    {
+        Header h;
+        if (!read_header(p, end, h) || !fits(h, p, end))
+        {
+            p = end;
+            break;
+        }
+
+        p += h.size + h.payload;
+        n += h.count - 1;
+    }
+    return n;
+}
+
+inline std::uint64_t skip(char const*& p, char const* const end, std::uint64_t n)
+{
+    return skip(p, end, n, end);
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_FORMAT_HPP
@@ -0,0 +1,179 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_PUSH_HPP
+#define MSGSCAN_PUSH_HPP
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+#include "msgscan/format.hpp"
+#include "msgscan/visitor.hpp"
+
+
+namespace msgscan
+{
+
+// Everything push() needs to carry on where the previous chunk ended.  A plain value: copy it
+// to checkpoint a parse, and resume from the copy later with the bytes that followed.
+struct PushState
+{
+    struct Frame
+    {
+        Token token;
+        std::uint64_t remaining; // Elements still to come.
+    };
+
+    std::uint64_t offset = 0;   // Of the next byte to be pushed.
+    std::vector<Frame> stack;   // Containers entered and not yet complete, innermost last.
+
+    // Start of an object cut short by the end of a chunk: its header, and its payload too unless
+    // it is being skipped, since visitors are given whole objects.
+    std::vector<char> held;
+
+    std::uint64_t skipping = 0; // Objects of a declined container still to skip,
+    Token skipped{};            // that container,
+    std::uint64_t gap = 0;      // and payload bytes of the object being skipped still to come.
+};
+
+
+// Reports the objects in the next chunk of a stream to `visitor`, exactly as scan() would
+// report the whole stream: a stream gives the same events however it is cut into chunks.
+// Each byte is looked at once; only objects split between chunks are copied, to be reported
+// whole, and of those only the header if they are being skipped.
+template <class Visitor>
+void push(PushState& s, char const* const begin, char const* const end, Visitor& visitor)
+{
+    auto const close = [&](Token token)
+    {
+        if (is_map(token.type))
+        {
+            visitor.end_map(token);
+        }
+        else
+        {
+            visitor.end_array(token);
+        }
+    };
+
+    // An element is complete; so are the containers it was the last element of.
+    auto const complete = [&]
+    {
+        while (!s.stack.empty() && --s.stack.back().remaining == 0)
+        {
+            auto const closed = s.stack.back().token;
+            s.stack.pop_back();
+            close(closed);
+        }
+    };
+
+    // Appends to `held` until it has `n` bytes; returns false if the chunk runs out first.
+    auto p = begin;
+    auto const take = [&](std::size_t n)
+    {
+        auto const available = static_cast<std::size_t>(end - p);
+        auto const count = std::min(n - std::min(n, s.held.size()), available);
+        s.held.insert(s.held.end(), p, p + count);
+        p += count;
+        return s.held.size() >= n;
+    };
+
+    for (;;)
+    {
+        if (s.gap != 0)
+        {
+            auto const n = std::min<std::uint64_t>(s.gap, static_cast<std::uint64_t>(end - p));
+            p += n;
+            s.gap -= n;
+            if (s.gap != 0) { break; }
+
+            if (s.skipping == 0) { complete(); }
+            continue;
+        }
+        if (p == end) { break; }
+
+        Token token;
+        Header h;
+        char const* object = p;
+        if (s.held.empty() && read_header(p, end, h) && (s.skipping != 0 || fits(h, p, end)))
+        {
+            token = Token{s.offset + static_cast<std::uint64_t>(p - begin), static_cast<std::uint8_t>(*p)};
+            p += s.skipping != 0 ? h.size : h.size + h.payload;
+        }
+        else
+        {
+            // Collect the object until it is whole: its header first, then what that says follows.
+            if (s.held.empty()) { s.held.push_back(*p++); }
+
+            auto const& d = descriptor(static_cast<unsigned char>(s.held[0]));
+            if (!take(d.size)) { break; }
+            h = read_header(d, s.held.data());
+            if (s.skipping == 0 && !take(d.size + h.payload)) { break; }
+
+            token = Token{s.offset + static_cast<std::uint64_t>(p - begin) - s.held.size(), static_cast<std::uint8_t>(s.held[0])};
+            object = s.held.data();
+        }
+
+        if (s.skipping != 0)
+        {
+            s.held.clear();
+            s.skipping += h.count - 1;
+            s.gap = h.payload;
+            if (s.skipping == 0 && s.gap == 0) { complete(); }
+            continue;
+        }
+
+        auto const entered = visit(descriptor(token.type), h, object, token.offset, visitor);
+        s.held.clear();
+
+        if (entered && h.count)
+        {
+            s.stack.push_back(PushState::Frame{token, h.count});
+            continue;
+        }
+
+        if (entered)
+        {
+            close(token);
+        }
+        else if (h.count)
+        {
+            s.skipping = h.count;
+            s.skipped = token;
+            continue;
+        }
+        complete();
+    }
+
+    s.offset += static_cast<std::uint64_t>(end - begin);
+}
+
+// Ends a stream parsed with push().  Returns false if it ends in the middle of an object,
+// which is reported by on_truncated as scan() would.
+template <class Visitor>
+bool finish(PushState const& s, Visitor& visitor)
+{
+    if (s.skipping != 0 || s.gap != 0)
+    {
+        visitor.on_truncated(s.skipped);
+        return false;
+    }
+    if (!s.held.empty())
+    {
+        visitor.on_truncated(Token{s.offset - s.held.size(), static_cast<std::uint8_t>(s.held[0])});
+        return false;
+    }
+    if (!s.stack.empty())
+    {
+        visitor.on_truncated(s.stack.back().token);
+        return false;
+    }
+    return true;
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_PUSH_HPP
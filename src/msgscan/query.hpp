@@ -0,0 +1,675 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_QUERY_HPP
+#define MSGSCAN_QUERY_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "msgscan/visitor.hpp"
+
+
+namespace msgscan
+{
+
+// One step of a path: a map entry by key, an array element (or map entry with an integer
+// key) by index, or every element.
+struct Step
+{
+    enum class Kind : std::uint8_t { key, index, any };
+
+    Kind kind;
+    std::string key;
+    std::uint64_t index;
+};
+
+// A value to compare with.  Numbers compare with every numeric type; integers exactly.
+struct Literal
+{
+    enum class Kind : std::uint8_t { nil, boolean, number, string };
+
+    Kind kind = Kind::nil;
+    bool boolean = false;
+    bool integral = false;       // An integer in the range of int64 or uint64.
+    bool negative = false;
+    std::int64_t integer = 0;    // If negative.
+    std::uint64_t natural = 0;   // If not.
+    double number = 0;
+    std::string text;
+};
+
+enum class Compare : std::uint8_t { eq, ne, lt, le, gt, ge };
+
+// Selects the objects at `select` in each record; if `filtered`, only in the records having
+// some object at `where` that compares with `value` as `op` says.
+//
+//   query   := path [ "where" path op literal ]
+//   path    := "." | step+
+//   step    := "." name | "." "*" | "[" digits "]" | "[" "*" "]" | "[" quoted "]"
+//   op      := "==" | "!=" | "<" | "<=" | ">" | ">="
+//   literal := number | quoted | "true" | "false" | "nil" | "null"
+//
+// For example `.events[*].latency_ms where .status == 500`.
+struct PathQuery
+{
+    std::vector<Step> select;
+    bool filtered = false;
+    std::vector<Step> where;
+    Compare op = Compare::eq;
+    Literal value;
+};
+
+
+inline bool name_char(char c)
+{
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_' || c == '-';
+}
+
+// Appends to `path` the step to the value of the str key `key`: ".key" if the key is a plain
+// name, else ["key"], quoted.
+inline void append_key_step(std::string& path, char const* key, std::uint32_t length)
+{
+    if (length && std::all_of(key, key + length, name_char))
+    {
+        path += '.';
+        path.append(key, length);
+        return;
+    }
+
+    path += "[\"";
+    for (auto p = key; p != key + length; ++p)
+    {
+        if (*p == '"' || *p == '\\') { path += '\\'; }
+        path += *p;
+    }
+    path += "\"]";
+}
+
+
+namespace detail
+{
+
+struct QueryParser
+{
+    char const* p;
+    char const* const end;
+    char const* error = nullptr;
+
+    void space()
+    {
+        while (p != end && (*p == ' ' || *p == '\t')) { ++p; }
+    }
+
+    bool eat(char const* word)
+    {
+        auto const n = std::strlen(word);
+        if (static_cast<std::size_t>(end - p) < n || std::memcmp(p, word, n) != 0) { return false; }
+        p += n;
+        return true;
+    }
+
+    bool fail(char const* what)
+    {
+        if (!error) { error = what; }
+        return false;
+    }
+
+    bool quoted(std::string& out)
+    {
+        ++p;
+        while (p != end && *p != '"')
+        {
+            if (*p == '\\' && ++p == end) { break; }
+            out += *p++;
+        }
+        if (p == end) { return fail("unterminated string"); }
+        ++p;
+        return true;
+    }
+
+    bool path(std::vector<Step>& steps)
+    {
+        space();
+        if (p == end || (*p != '.' && *p != '[')) { return fail("expected a path starting with '.' or '['"); }
+
+        while (p != end && (*p == '.' || *p == '['))
+        {
+            if (*p == '.')
+            {
+                ++p;
+                if (p != end && *p == '*')
+                {
+                    ++p;
+                    steps.push_back(Step{Step::Kind::any, {}, 0});
+                    continue;
+                }
+
+                auto const start = p;
+                while (p != end && msgscan::name_char(*p)) { ++p; }
+                if (p != start) { steps.push_back(Step{Step::Kind::key, {start, p}, 0}); }
+
+                // A lone "." is the record itself, and only valid as the whole path.
+                else if (!steps.empty() || (p != end && (*p == '.' || *p == '['))) { return fail("expected a key after '.'"); }
+                continue;
+            }
+
+            ++p;
+            if (p != end && *p == '*')
+            {
+                ++p;
+                steps.push_back(Step{Step::Kind::any, {}, 0});
+            }
+            else if (p != end && *p == '"')
+            {
+                std::string key;
+                if (!quoted(key)) { return false; }
+                steps.push_back(Step{Step::Kind::key, std::move(key), 0});
+            }
+            else
+            {
+                std::uint64_t index = 0;
+                auto const start = p;
+                for (; p != end && '0' <= *p && *p <= '9'; ++p) { index = index * 10 + static_cast<unsigned>(*p - '0'); }
+                if (p == start) { return fail("expected an index, '*' or a quoted key after '['"); }
+                steps.push_back(Step{Step::Kind::index, {}, index});
+            }
+            if (p == end || *p != ']') { return fail("expected ']'"); }
+            ++p;
+        }
+        return true;
+    }
+
+    bool literal(Literal& out)
+    {
+        space();
+        if (p != end && *p == '"')
+        {
+            out.kind = Literal::Kind::string;
+            return quoted(out.text);
+        }
+        if (eat("true"))
+        {
+            out.kind = Literal::Kind::boolean;
+            out.boolean = true;
+            return true;
+        }
+        if (eat("false"))
+        {
+            out.kind = Literal::Kind::boolean;
+            return true;
+        }
+        if (eat("nil") || eat("null"))
+        {
+            out.kind = Literal::Kind::nil;
+            return true;
+        }
+
+        auto const start = p;
+        while (p != end && p[0] != ' ' && p[0] != '\t') { ++p; }
+        std::string const text{start, p};
+        if (text.empty()) { return fail("expected a value to compare with"); }
+
+        char* stop;
+        out.number = std::strtod(text.c_str(), &stop);
+        if (*stop) { return fail("expected a number, a quoted string, true, false or nil"); }
+        out.kind = Literal::Kind::number;
+
+        // Integers too large for either type compare as doubles.
+        errno = 0;
+        if (text[0] == '-')
+        {
+            out.integer = std::strtoll(text.c_str(), &stop, 10);
+            out.negative = out.integer < 0; // "-0" is 0.
+        }
+        else { out.natural = std::strtoull(text.c_str(), &stop, 10); }
+        out.integral = !*stop && errno != ERANGE;
+        return true;
+    }
+
+    bool compare(Compare& op)
+    {
+        space();
+        if (eat("==")) { op = Compare::eq; }
+        else if (eat("!=")) { op = Compare::ne; }
+        else if (eat("<=")) { op = Compare::le; }
+        else if (eat(">=")) { op = Compare::ge; }
+        else if (eat("<")) { op = Compare::lt; }
+        else if (eat(">")) { op = Compare::gt; }
+        else { return fail("expected ==, !=, <, <=, > or >="); }
+        return true;
+    }
+};
+
+} // namespace detail
+
+
+// Parses `text` into `query`.  Returns nullptr, or what is wrong with the text.
+inline char const* parse(std::string const& text, PathQuery& query)
+{
+    detail::QueryParser parser{text.data(), text.data() + text.size()};
+    query = PathQuery{};
+
+    if (!parser.path(query.select)) { return parser.error; }
+    parser.space();
+    if (parser.eat("where"))
+    {
+        query.filtered = true;
+        if (!parser.path(query.where) || !parser.compare(query.op) || !parser.literal(query.value)) { return parser.error; }
+        parser.space();
+    }
+    if (parser.p != parser.end) { return "unexpected text after the query"; }
+    return nullptr;
+}
+
+
+// Evaluates a path query over a scan, in a single pass.  Only containers on the way to the
+// selected or compared objects are entered; everything else is skipped by its header, so
+// memory use is bounded by the depth of the paths.  Matches are reported as they are met; the
+// one exception is a filtered query whose record has not passed its filter yet, for which the
+// matches of that record alone are held until it passes or ends.
+// `found(offset)` is called with `base` plus the offset of each match, in file order.
+template <class Found>
+class QueryVisitor final : public BasicVisitor
+{
+public:
+    QueryVisitor(PathQuery const& query, std::uint64_t base, Found found)
+      : query(query), base{base}, found(found) { }
+
+    void on_nil(Token t) { scalar(t, [&]{ return query.value.kind == Literal::Kind::nil ? 0 : unordered; }); }
+    void on_never_used(Token t) { scalar(t, []{ return unordered; }); }
+
+    void on_bool(Token t, bool value)
+    {
+        scalar(t, [&]{ return query.value.kind == Literal::Kind::boolean ? (value == query.value.boolean ? 0 : unordered) : unordered; }, Key{Key::other});
+    }
+
+    void on_uint(Token t, std::uint64_t value)
+    {
+        auto const& v = query.value;
+        scalar(t, [&]
+        {
+            if (v.kind != Literal::Kind::number) { return unordered; }
+            if (!v.integral) { return order(static_cast<double>(value), v.number); }
+            return v.negative ? 1 : order(value, v.natural);
+        }, Key{Key::number, value});
+    }
+
+    void on_int(Token t, std::int64_t value)
+    {
+        auto const& v = query.value;
+        scalar(t, [&]
+        {
+            if (v.kind != Literal::Kind::number) { return unordered; }
+            if (!v.integral) { return order(static_cast<double>(value), v.number); }
+            if (v.negative) { return order(value, v.integer); }
+            return value < 0 ? -1 : order(static_cast<std::uint64_t>(value), v.natural);
+        }, value < 0 ? Key{Key::other} : Key{Key::number, static_cast<std::uint64_t>(value)});
+    }
+
+    void on_float(Token t, double value)
+    {
+        scalar(t, [&]{ return query.value.kind == Literal::Kind::number ? order(value, query.value.number) : unordered; });
+    }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        auto const& v = query.value;
+        scalar(t, [&]
+        {
+            if (v.kind != Literal::Kind::string) { return unordered; }
+            auto const c = std::memcmp(data, v.text.data(), length < v.text.size() ? length : v.text.size());
+            return c ? (c < 0 ? -1 : 1) : order<std::size_t>(length, v.text.size());
+        }, Key{Key::text, 0, data, length});
+    }
+
+    void on_bin(Token t, char const*, std::uint32_t) { scalar(t, []{ return unordered; }); }
+    void on_ext(Token t, std::int8_t, char const*, std::uint32_t) { scalar(t, []{ return unordered; }); }
+
+    bool begin_array(Token t, std::uint32_t) { return begin(t, false); }
+    bool begin_map(Token t, std::uint32_t) { return begin(t, true); }
+    void end_array(Token) { end(); }
+    void end_map(Token) { end(); }
+
+    // A record cut short keeps the matches reported from it.
+    void on_truncated(Token)
+    {
+        frames.clear();
+        end_record();
+    }
+
+private:
+    static constexpr std::uint32_t off_path = ~std::uint32_t{0};
+    static constexpr int unordered = 2;
+
+    // How many steps of each path lead to the next element of a container entered.
+    struct Frame
+    {
+        std::uint32_t select;
+        std::uint32_t where;
+        bool map;
+        bool key;
+        std::uint64_t index;
+
+        // For a map, how far the key just seen leads.
+        std::uint32_t value_select;
+        std::uint32_t value_where;
+    };
+
+    // A map key as far as steps are concerned.
+    struct Key
+    {
+        enum Kind { other, number, text } kind;
+        std::uint64_t integer;
+        char const* data;
+        std::uint32_t length;
+
+        Key(Kind kind, std::uint64_t integer = 0, char const* data = nullptr, std::uint32_t length = 0)
+          : kind{kind}, integer{integer}, data{data}, length{length} { }
+    };
+
+    template <class T>
+    static int order(T a, T b) { return a < b ? -1 : b < a ? 1 : 0; }
+
+    // Follows one more step from `depth` steps of `path`, or stays off it.
+    static std::uint32_t follow(std::vector<Step> const& path, std::uint32_t depth, bool map, std::uint64_t index, Key const& key)
+    {
+        if (depth == off_path || depth >= path.size()) { return off_path; }
+
+        auto const& step = path[depth];
+        switch (step.kind)
+        {
+        case Step::Kind::any:
+            return depth + 1;
+        case Step::Kind::index:
+            if (!map) { return step.index == index ? depth + 1 : off_path; }
+            return key.kind == Key::number && key.integer == step.index ? depth + 1 : off_path;
+        case Step::Kind::key:
+            return map && key.kind == Key::text && key.length == step.key.size() && std::memcmp(key.data, step.key.data(), key.length) == 0 ? depth + 1 : off_path;
+        }
+        return off_path;
+    }
+
+    // How far each path leads to the object being reported: a record starts both, an element
+    // follows its container's step.  Returns false for a map key, which only decides how far
+    // its value leads.
+    bool position(std::uint32_t& select, std::uint32_t& where, Key const& key)
+    {
+        if (frames.empty())
+        {
+            select = 0;
+            where = 0;
+            return true;
+        }
+
+        auto& f = frames.back();
+        if (f.map && f.key)
+        {
+            f.value_select = follow(query.select, f.select, true, 0, key);
+            f.value_where = follow(query.where, f.where, true, 0, key);
+            return false;
+        }
+        if (f.map)
+        {
+            select = f.value_select;
+            where = f.value_where;
+        }
+        else
+        {
+            select = follow(query.select, f.select, false, f.index, key);
+            where = follow(query.where, f.where, false, f.index, key);
+        }
+        return true;
+    }
+
+    template <class Order>
+    void scalar(Token t, Order order, Key const& key = Key{Key::other})
+    {
+        std::uint32_t select, where;
+        if (position(select, where, key))
+        {
+            if (select == query.select.size()) { selected(t); }
+            if (query.filtered && where == query.where.size() && !passed && test(order())) { pass(); }
+        }
+        next();
+    }
+
+    bool begin(Token t, bool map)
+    {
+        std::uint32_t select, where;
+        if (!position(select, where, Key{Key::other}))
+        {
+            next();
+            return false;
+        }
+
+        if (select == query.select.size()) { selected(t); }
+        if (query.filtered && where == query.where.size() && !passed && test(unordered)) { pass(); }
+
+        if (select < query.select.size() || (query.filtered && where < query.where.size()))
+        {
+            frames.push_back(Frame{select, query.filtered ? where : off_path, map, true, 0, off_path, off_path});
+            return true;
+        }
+        next();
+        return false;
+    }
+
+    void end()
+    {
+        frames.pop_back();
+        next();
+    }
+
+    // Moves past the object just reported, ending the record if it was the top-level one.
+    void next()
+    {
+        if (frames.empty())
+        {
+            end_record();
+            return;
+        }
+
+        auto& f = frames.back();
+        if (f.map && f.key)
+        {
+            f.key = false;
+            return;
+        }
+        f.key = true;
+        ++f.index;
+    }
+
+    bool test(int order) const
+    {
+        switch (query.op)
+        {
+        case Compare::eq: return order == 0;
+        case Compare::ne: return order != 0;
+        case Compare::lt: return order == -1;
+        case Compare::le: return order == -1 || order == 0;
+        case Compare::gt: return order == 1;
+        case Compare::ge: return order == 1 || order == 0;
+        }
+        return false;
+    }
+
+    void selected(Token t)
+    {
+        if (!query.filtered || passed) { found(base + t.offset); }
+        else { pending.push_back(base + t.offset); }
+    }
+
+    // The record passes: what it held so far comes before anything selected later.
+    void pass()
+    {
+        passed = true;
+        for (auto const offset : pending) { found(offset); }
+        pending.clear();
+    }
+
+    // Matches of a record that never passed are dropped.
+    void end_record()
+    {
+        pending.clear();
+        passed = false;
+    }
+
+    PathQuery const& query;
+    std::uint64_t const base;
+    Found found;
+    std::vector<Frame> frames;
+    std::vector<std::uint64_t> pending; // Only while the filter is undecided.
+    bool passed = false;
+};
+
+template <class Found>
+QueryVisitor<Found> make_query_visitor(PathQuery const& query, std::uint64_t base, Found found)
+{
+    return QueryVisitor<Found>{query, base, found};
+}
+
+
+namespace detail
+{
+
+// Keeps the path of the object being scanned, and reports it for the offsets wanted.
+template <class Found>
+class PathVisitor final : public BasicVisitor
+{
+public:
+    PathVisitor(std::uint64_t base, std::uint64_t const* hits, std::uint64_t const* last, Found& found)
+      : base{base}, hit{hits}, last{last}, found(found) { }
+
+    void on_nil(Token t) { object(t); }
+    void on_never_used(Token t) { object(t); }
+    void on_bool(Token t, bool) { object(t); }
+    void on_float(Token t, double) { object(t); }
+    void on_bin(Token t, char const*, std::uint32_t) { object(t); }
+    void on_ext(Token t, std::int8_t, char const*, std::uint32_t) { object(t); }
+    void on_truncated(Token) { hit = last; }
+
+    void on_uint(Token t, std::uint64_t value)
+    {
+        if (key()) { index_step(value); }
+        else { object(t); }
+    }
+
+    void on_int(Token t, std::int64_t value)
+    {
+        if (!key()) { object(t); }
+        else if (value >= 0) { index_step(static_cast<std::uint64_t>(value)); }
+    }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        if (!key()) { object(t); }
+        else
+        {
+            step.clear();
+            append_key_step(step, data, length);
+        }
+    }
+
+    bool begin_array(Token t, std::uint32_t) { return begin(t, false); }
+    bool begin_map(Token t, std::uint32_t) { return begin(t, true); }
+    void end_array(Token) { frames.pop_back(); }
+    void end_map(Token) { frames.pop_back(); }
+
+private:
+    struct Frame
+    {
+        bool map;
+        bool key;            // The next element of a map is a key.
+        std::uint64_t index; // Of the next element of an array.
+        std::size_t length;  // Of the path of the container.
+    };
+
+    // Whether the object is a map key; if so, moves past it, with ".*" as the step to its value
+    // unless the key says otherwise.
+    bool key()
+    {
+        if (frames.empty() || !frames.back().map || !frames.back().key) { return false; }
+        frames.back().key = false;
+        step.assign(".*");
+        return true;
+    }
+
+    void index_step(std::uint64_t index)
+    {
+        step.assign("[");
+        step += std::to_string(index);
+        step += ']';
+    }
+
+    // Makes `path` that of the object at `t`, and reports it if wanted.
+    void object(Token t)
+    {
+        if (!frames.empty())
+        {
+            auto& f = frames.back();
+            path.resize(f.length);
+            if (f.map)
+            {
+                path += step;
+                f.key = true;
+            }
+            else
+            {
+                index_step(f.index++);
+                path += step;
+            }
+        }
+        // Offsets not of an object reported here, such as of a key, are passed over.
+        while (hit != last && *hit < base + t.offset) { ++hit; }
+        if (hit != last && *hit == base + t.offset)
+        {
+            found(*hit, path.empty() ? root : path);
+            ++hit;
+        }
+    }
+
+    bool begin(Token t, bool map)
+    {
+        if (key()) { return false; }
+
+        object(t);
+        if (hit == last) { return false; }
+        frames.push_back(Frame{map, true, 0, path.size()});
+        return true;
+    }
+
+    std::string const root{"."};
+    std::uint64_t const base;
+    std::uint64_t const* hit;
+    std::uint64_t const* const last;
+    Found& found;
+    std::vector<Frame> frames;
+    std::string path;
+    std::string step; // To the value of the map key just seen.
+};
+
+} // namespace detail
+
+// Calls found(offset, path) for each of the offsets in [hits, last), all within the record in
+// [record, end) found at `base` and in increasing order, with the path of the object there as
+// in a query, but concrete: "." for the record, ".key" or ["key"] for the value of a str key,
+// "[n]" for an array element or the value of an integer key, and ".*" for any other key.  The
+// record is scanned once for all of them.
+template <class Found>
+void find_paths(char const* record, char const* end, std::uint64_t base, std::uint64_t const* hits, std::uint64_t const* last, Found found)
+{
+    detail::PathVisitor<Found> visitor{base, hits, last, found};
+    scan(record, end, visitor);
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_QUERY_HPP
@@ -0,0 +1,293 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_RECORDS_HPP
+#define MSGSCAN_RECORDS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "msgscan/format.hpp"
+
+
+namespace msgscan
+{
+
+// Appends to `records` the offset of every top-level object (record) in [begin, end), from
+// `p` on, until `p` reaches `stop`; `p` is left at the start of the first record at or after
+// `stop`.  Returns false if a record is cut short by `end`; its offset is the last one
+// appended and `p` is left at `end`.
+inline bool find_records(char const* const begin, char const*& p, char const* const end, char const* const stop, std::vector<std::uint64_t>& records)
+{
+    while (p < stop)
+    {
+        records.push_back(static_cast<std::uint64_t>(p - begin));
+        if (skip(p, end, 1)) { return false; }
+    }
+    return true;
+}
+
+namespace detail
+{
+
+// Reports how far a walk over [begin, end) has got, roughly every thousandth of the input.
+template <class Progress>
+struct RecordProgress
+{
+    RecordProgress(char const* begin, char const* end, Progress& progress)
+      : begin(begin), end(end), step(std::max<std::ptrdiff_t>((end - begin) / 1000, 1 << 20)), next(begin), progress(progress)
+    {
+        advance(begin);
+    }
+
+    // Where the walk has to stop next to report.
+    char const* due() const noexcept { return next; }
+
+    // Reports `p` if due; returns false if cancelled.
+    bool report(char const* p)
+    {
+        if (p < next || p >= end) { return true; }
+        advance(p);
+        return progress(p - begin);
+    }
+
+    void advance(char const* p) { next = end - p > step ? p + step : end; }
+
+    char const* const begin;
+    char const* const end;
+    std::ptrdiff_t const step;
+    char const* next;
+    Progress& progress;
+};
+
+// As find_records(begin, p, end, stop, records), reporting progress on the way, also while
+// skipping a single large record.  Sets `truncated` if a record is cut short by `end`.
+// Returns false if cancelled.
+template <class Progress>
+bool find_records(char const* const begin, char const*& p, char const* const end, char const* const stop, std::vector<std::uint64_t>& records, bool& truncated, RecordProgress<Progress>& reporter)
+{
+    while (p < stop)
+    {
+        records.push_back(static_cast<std::uint64_t>(p - begin));
+
+        std::uint64_t n = 1;
+        while ((n = skip(p, end, n, reporter.due())) && p < end)
+        {
+            if (!reporter.report(p)) { return false; }
+        }
+        truncated = truncated || n != 0;
+
+        if (!reporter.report(p)) { return false; }
+    }
+    return true;
+}
+
+// Skips the object at `p` if it ends at or before `limit`; returns false otherwise.  Adds the
+// bytes of the headers read to `scanned`: payloads are jumped over, so that is what it costs.
+inline bool skip_within(char const*& p, char const* const limit, std::ptrdiff_t& scanned)
+{
+    std::uint64_t n = 1;
+    while (n)
+    {
+        Header h;
+        if (!read_header(p, limit, h) || !fits(h, p, limit))
+        {
+            ++scanned;
+            return false;
+        }
+
+        scanned += h.size;
+        p += h.size + h.payload;
+        n += h.count - 1;
+    }
+    return true;
+}
+
+} // namespace detail
+
+// Offsets of the records in [begin, end), collected on one thread.  `truncated` is set if the
+// last record is cut short by `end`.  `progress(consumed)` is called with the number of bytes
+// consumed so far, roughly every thousandth of the input, also while skipping a single large
+// record; returning false cancels the pass.
+template <class Progress>
+bool find_records(char const* const begin, char const* const end, std::vector<std::uint64_t>& records, bool& truncated, Progress&& progress)
+{
+    detail::RecordProgress<Progress> reporter{begin, end, progress};
+
+    truncated = false;
+    auto p = begin;
+    return detail::find_records(begin, p, end, end, records, truncated, reporter);
+}
+
+
+// As find_records, split over up to `workers` threads.
+//
+// The input is cut into equal chunks.  Each worker walks its chunk from the chunk's first
+// byte, as if a record started there, and notes where each object it skips starts: a guess
+// that is usually wrong for the first few objects, but skipping whole objects tends to fall
+// into step with the real records within a record or two.  A sequential pass then follows the
+// true record boundaries from the start of the input: on reaching a chunk, it looks up the
+// true position among the worker's guesses, and from there on the worker's list is exact,
+// since skipping from the same offset always yields the same objects.  Chunks where the
+// guesses never meet the true boundaries are walked again sequentially, so the result is
+// always the same as find_records'; only the speedup depends on the data.  A guess has to fit
+// in its chunk and the next, so a wrong one that reads as a huge str or array costs no more
+// than the bytes it actually walks.
+//
+// `progress` is only ever called from the calling thread: with the bytes walked by the
+// workers while they run, then with the offset reached by the sequential pass once that is
+// further, so that it never goes back.
+template <class Progress>
+bool find_records(char const* const begin, char const* const end, std::vector<std::uint64_t>& records, bool& truncated, unsigned workers, Progress&& progress)
+{
+    // Below this a chunk is not worth a thread.
+    constexpr std::ptrdiff_t min_chunk = std::ptrdiff_t{16} << 20;
+
+    auto const size = end - begin;
+    auto const chunks = static_cast<std::size_t>(std::min<std::ptrdiff_t>(workers, size / min_chunk));
+    if (chunks <= 1) { return find_records(begin, end, records, truncated, progress); }
+
+    auto const chunk_size = size / static_cast<std::ptrdiff_t>(chunks);
+    auto const chunk_begin = [&](std::size_t k) { return begin + static_cast<std::ptrdiff_t>(k) * chunk_size; };
+    auto const chunk_end = [&](std::size_t k) { return k + 1 == chunks ? end : chunk_begin(k + 1); };
+
+    // What a worker found: the guessed record offsets in its chunk, and where its walk ended,
+    // normally at or after the chunk's end.  An object running past the next chunk as well (or
+    // past the input) is not skipped but left to the sequential pass, and noted as a gap; the
+    // walk goes on from the next byte, so guesses after a gap do not continue the ones before
+    // it.
+    struct Guess
+    {
+        std::vector<std::uint64_t> records;
+        std::vector<std::uint64_t> gaps;
+        char const* resume;
+    };
+    std::vector<Guess> guesses(chunks);
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<std::uint64_t> consumed{0};
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t running = chunks;
+
+    auto const work = [&](std::size_t k)
+    {
+        auto& g = guesses[k];
+        auto const stop = chunk_end(k);
+        auto const limit = end - stop > chunk_size ? stop + chunk_size : end;
+
+        // Walks that fail are retried a byte later, so random data could otherwise make a
+        // worker go over the same bytes again and again.
+        auto wasted = std::ptrdiff_t{0};
+
+        auto p = chunk_begin(k);
+        auto reported = p;
+        while (p < stop && !cancelled.load(std::memory_order_relaxed))
+        {
+            auto const start = p;
+            auto scanned = std::ptrdiff_t{0};
+            if (!detail::skip_within(p, limit, scanned))
+            {
+                g.gaps.push_back(static_cast<std::uint64_t>(start - begin));
+                wasted += scanned;
+                p = start + 1;
+                if (wasted > 4 * chunk_size) { break; }
+                continue;
+            }
+            g.records.push_back(static_cast<std::uint64_t>(start - begin));
+
+            // Only what is in the chunk counts; what runs past it is the next chunk's.
+            auto const at = std::min(p, stop);
+            if (at - reported >= min_chunk / 16)
+            {
+                consumed.fetch_add(static_cast<std::uint64_t>(at - reported), std::memory_order_relaxed);
+                reported = at;
+            }
+        }
+        g.resume = p;
+        consumed.fetch_add(static_cast<std::uint64_t>(std::min(p, stop) - reported), std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        --running;
+        finished.notify_one();
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks);
+    for (std::size_t k = 0; k != chunks; ++k)
+    {
+        threads.emplace_back(work, k);
+    }
+
+    // Report progress while the workers run; the sequential pass is quick in comparison.
+    auto ok = true;
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        while (running)
+        {
+            finished.wait_for(lock, std::chrono::milliseconds{50});
+            lock.unlock();
+            if (ok && !progress(static_cast<std::ptrdiff_t>(consumed.load(std::memory_order_relaxed))))
+            {
+                ok = false;
+                cancelled = true;
+            }
+            lock.lock();
+        }
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    if (!ok) { return false; }
+
+    // What the workers reported stands until the sequential pass gets further.
+    auto const walked = static_cast<std::ptrdiff_t>(consumed.load(std::memory_order_relaxed));
+    auto sequential = [&](std::ptrdiff_t at) { return progress(std::max(at, walked)); };
+    detail::RecordProgress<decltype(sequential)> reporter{begin, end, sequential};
+
+    truncated = false;
+    auto p = begin;
+    for (std::size_t k = 0; k != chunks && p < end; ++k)
+    {
+        auto const stop = chunk_end(k);
+        if (p >= stop) { continue; }
+
+        auto const& g = guesses[k];
+        auto const offset = static_cast<std::uint64_t>(p - begin);
+        auto const found = std::lower_bound(g.records.begin(), g.records.end(), offset);
+        if (found != g.records.end() && *found == offset)
+        {
+            auto const gap = std::lower_bound(g.gaps.begin(), g.gaps.end(), offset);
+            if (gap == g.gaps.end())
+            {
+                records.insert(records.end(), found, g.records.end());
+                p = g.resume;
+            }
+            else
+            {
+                records.insert(records.end(), found, std::lower_bound(found, g.records.end(), *gap));
+                p = begin + *gap;
+            }
+        }
+
+        // The rest of the chunk, if the guesses never met the records or hit a gap.
+        if (!reporter.report(p)) { return false; }
+        if (!detail::find_records(begin, p, end, stop, records, truncated, reporter)) { return false; }
+    }
+    return true;
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_RECORDS_HPP
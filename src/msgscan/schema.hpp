@@ -0,0 +1,532 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_SCHEMA_HPP
+#define MSGSCAN_SCHEMA_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "msgscan/format.hpp"
+#include "msgscan/query.hpp"
+#include "msgscan/visitor.hpp"
+
+
+namespace msgscan
+{
+
+// What was seen at one path: how often, of which kinds, how long (bytes of strs, bins and
+// exts, elements of arrays and maps) and, for numbers, in what range.  Also where the bytes
+// of the input go: for each kind, the encoded size of the objects, of which headers (type
+// byte, length, ext type), and for maps the encoded size of their keys.  The elements of
+// arrays and maps are counted at their own paths, so adding up every path gives the size of
+// the records.
+struct Shape
+{
+    // Kinds of objects told apart; the integer types are one kind, while the float types are
+    // two, as which one is used matters for size.
+    enum class Kind : std::uint8_t { nil, boolean, integer, float32, float64, str, bin, ext, array, map, invalid };
+
+    static constexpr std::size_t kind_count = 11;
+
+    static char const* kind_name(Kind kind) noexcept
+    {
+        static char const* const names[kind_count] = { "nil", "bool", "int", "float32", "float64", "str", "bin", "ext", "array", "map", "invalid" };
+        return names[static_cast<std::size_t>(kind)];
+    }
+
+    std::uint64_t count = 0;
+    std::uint64_t kinds[kind_count] = {};
+    std::uint64_t min_length = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t max_length = 0;
+    double min_value = std::numeric_limits<double>::infinity();
+    double max_value = -std::numeric_limits<double>::infinity();
+    std::uint64_t bytes[kind_count] = {};
+    std::uint64_t header_bytes[kind_count] = {};
+    std::uint64_t keys = 0;
+    std::uint64_t key_bytes = 0;
+    std::uint64_t key_header_bytes = 0;
+
+    bool has_length() const noexcept { return min_length <= max_length; }
+    bool has_value() const noexcept { return min_value <= max_value; }
+
+    void add(Kind kind)
+    {
+        ++count;
+        ++kinds[static_cast<std::size_t>(kind)];
+    }
+
+    void add_length(std::uint64_t length)
+    {
+        min_length = std::min(min_length, length);
+        max_length = std::max(max_length, length);
+    }
+
+    void add_value(double value)
+    {
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    void add_bytes(Kind kind, std::uint64_t header, std::uint64_t payload)
+    {
+        bytes[static_cast<std::size_t>(kind)] += header + payload;
+        header_bytes[static_cast<std::size_t>(kind)] += header;
+    }
+
+    void add_key(std::uint64_t header, std::uint64_t payload)
+    {
+        ++keys;
+        add_key_bytes(header, payload);
+    }
+
+    // Bytes of an object nested in a key.
+    void add_key_bytes(std::uint64_t header, std::uint64_t payload)
+    {
+        key_bytes += header + payload;
+        key_header_bytes += header;
+    }
+
+    // Bytes of the objects here, and of those the part that is not their values: headers and
+    // map keys, whole.
+    std::uint64_t total_bytes() const noexcept
+    {
+        std::uint64_t n = key_bytes;
+        for (auto b : bytes) { n += b; }
+        return n;
+    }
+
+    std::uint64_t overhead_bytes() const noexcept
+    {
+        std::uint64_t n = key_bytes;
+        for (auto b : header_bytes) { n += b; }
+        return n;
+    }
+
+    void merge(Shape const& other)
+    {
+        count += other.count;
+        for (std::size_t k = 0; k != kind_count; ++k)
+        {
+            kinds[k] += other.kinds[k];
+            bytes[k] += other.bytes[k];
+            header_bytes[k] += other.header_bytes[k];
+        }
+        keys += other.keys;
+        key_bytes += other.key_bytes;
+        key_header_bytes += other.key_header_bytes;
+        min_length = std::min(min_length, other.min_length);
+        max_length = std::max(max_length, other.max_length);
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+    }
+};
+
+
+// The paths found in records, as a tree, with the shape seen at each.  Paths are written as
+// in a path query: the record is ".", array elements "[*]", map values ".key", or ["key"] for
+// keys that are not plain names, and ".*" for keys that are not strs.  A map with more than
+// max_keys distinct keys at one path has all of them folded into ".*", so that memory use
+// depends on the number of distinct paths, and maps keyed by ids do not make that the size of
+// the data.  Whether a path is folded depends only on the keys seen there, not on the order
+// they came in, so the schema is the same however the input was split between threads.
+class Schema
+{
+public:
+    static constexpr std::uint32_t root = 0;
+    static constexpr std::uint32_t max_keys = 1000;
+
+    Schema() { paths.push_back(Path{root, {}, false, false, {}, 0, no_path, no_path, no_path}); }
+
+    Shape& shape(std::uint32_t path) { return paths[path].shape; }
+    std::size_t size() const noexcept { return paths.size(); }
+
+    // The path of an element of an array at `parent`.
+    std::uint32_t element(std::uint32_t parent) { return cached(parent, &Path::element, "[*]"); }
+
+    // The path of a map value at `parent` whose key is not a str.
+    std::uint32_t any_value(std::uint32_t parent) { return cached(parent, &Path::any, ".*"); }
+
+    // The path of a map value at `parent` whose key is the str `key`.
+    std::uint32_t value(std::uint32_t parent, char const* key, std::uint32_t length)
+    {
+        if (paths[parent].folded) { return any_value(parent); }
+
+        step.clear();
+        append_key_step(step, key, length);
+        return child(parent, step, true);
+    }
+
+    // Adds what `other` has seen to this schema.
+    void merge(Schema const& other)
+    {
+        // Parents come before their children, so each is mapped by the time its children are.
+        // Folding may move a path mapped earlier; forward() finds where it went.
+        std::vector<std::uint32_t> mapped(other.paths.size());
+        for (std::uint32_t i = 0; i != other.paths.size(); ++i)
+        {
+            auto const& p = other.paths[i];
+            if (p.forward != no_path) { continue; }
+
+            auto const id = i == root ? root : child(forward(mapped[p.parent]), p.step, p.key);
+            mapped[i] = id;
+            paths[id].shape.merge(p.shape);
+            if (p.folded && !paths[id].folded) { fold(id); }
+        }
+    }
+
+    // Every path seen, written out, with its shape, sorted by path.
+    std::vector<std::pair<std::string, Shape>> report() const
+    {
+        std::vector<std::pair<std::string, Shape>> result;
+        result.reserve(paths.size());
+        for (std::uint32_t i = 0; i != paths.size(); ++i)
+        {
+            if (!paths[i].shape.count || paths[i].forward != no_path) { continue; }
+
+            std::string name;
+            for (auto j = i; j != root; j = paths[j].parent)
+            {
+                name.insert(0, paths[j].step);
+            }
+            result.emplace_back(name.empty() ? std::string{"."} : std::move(name), paths[i].shape);
+        }
+        std::sort(result.begin(), result.end(), [](std::pair<std::string, Shape> const& a, std::pair<std::string, Shape> const& b) { return a.first < b.first; });
+        return result;
+    }
+
+private:
+    static constexpr std::uint32_t no_path = ~std::uint32_t{0};
+
+    struct Path
+    {
+        std::uint32_t parent;
+        std::string step;
+        bool key;              // A map value by str key, counted towards max_keys.
+        bool folded;           // Values by str key go under ".*".
+        Shape shape;
+        std::uint32_t keys;    // Distinct keys among the children.
+        std::uint32_t element; // Children looked up often enough to be worth keeping at hand.
+        std::uint32_t any;
+        std::uint32_t forward; // Where what was seen here went, once folded away.
+    };
+
+    std::uint32_t forward(std::uint32_t path) const
+    {
+        while (paths[path].forward != no_path) { path = paths[path].forward; }
+        return path;
+    }
+
+    std::uint32_t cached(std::uint32_t parent, std::uint32_t Path::* slot, char const* name)
+    {
+        if (paths[parent].*slot == no_path)
+        {
+            auto const id = child(parent, name, false);
+            paths[parent].*slot = id;
+        }
+        return paths[parent].*slot;
+    }
+
+    void index_key(std::uint32_t parent, std::string const& step)
+    {
+        lookup.assign(reinterpret_cast<char const*>(&parent), sizeof(parent));
+        lookup += step;
+    }
+
+    // Finds or adds the child `step` of `parent`; `key` tells that it counts towards max_keys.
+    std::uint32_t child(std::uint32_t parent, std::string const& step, bool key)
+    {
+        if (key && paths[parent].folded) { return any_value(parent); }
+
+        index_key(parent, step);
+        auto const found = index.find(lookup);
+        if (found != index.end()) { return found->second; }
+
+        if (key && paths[parent].keys == max_keys)
+        {
+            fold(parent);
+            return any_value(parent);
+        }
+
+        auto const id = static_cast<std::uint32_t>(paths.size());
+        paths.push_back(Path{parent, step, key, false, {}, 0, no_path, no_path, no_path});
+        paths[parent].keys += key;
+        index.emplace(lookup, id);
+        return id;
+    }
+
+    // Moves what was seen under each str key of `parent` to its ".*", merging the subtrees.
+    // The paths moved stay, empty, forwarding to where their contents went, so that ids held
+    // elsewhere can still be followed.
+    void fold(std::uint32_t parent)
+    {
+        paths[parent].folded = true;
+        auto const any = any_value(parent);
+
+        // Descendants come after `parent`; those added from here on are under ".*".
+        auto const n = static_cast<std::uint32_t>(paths.size());
+        std::vector<std::uint32_t> target(n - parent, std::uint32_t{no_path});
+        for (auto i = parent + 1; i != n; ++i)
+        {
+            auto const up = paths[i].parent;
+            std::uint32_t to;
+            if (up == parent && paths[i].key) { to = any; }
+            else if (up > parent && target[up - parent] != no_path)
+            {
+                auto const step = paths[i].step;
+                to = child(forward(target[up - parent]), step, paths[i].key);
+            }
+            else { continue; }
+
+            auto const shape = paths[i].shape;
+            auto const folded = paths[i].folded;
+            to = forward(to);
+            paths[to].shape.merge(shape);
+            if (folded && !paths[to].folded) { fold(to); }
+
+            target[i - parent] = to;
+            index_key(paths[i].parent, paths[i].step);
+            index.erase(lookup);
+            paths[i].forward = to;
+            paths[i].shape = Shape{};
+            std::string{}.swap(paths[i].step);
+        }
+    }
+
+    std::vector<Path> paths;
+    std::unordered_map<std::string, std::uint32_t> index; // Parent and step to child.
+    std::string step;   // Scratch space, kept to avoid allocating for every key.
+    std::string lookup;
+};
+
+
+// Adds the shape of every object scanned to a schema.  Memory use is that of the schema plus
+// one frame per level of nesting.  An array or map used as a map key is not looked into, but
+// all of its bytes count towards the key bytes.
+struct SchemaVisitor final : BasicVisitor
+{
+    using Kind = Shape::Kind;
+
+    explicit SchemaVisitor(Schema& schema) : schema(schema) { }
+
+    // Numbers have a payload of fixed size; strs, bins and exts report theirs.
+    void on_nil(Token t) { add(t, Kind::nil, 0); }
+    void on_never_used(Token t) { add(t, Kind::invalid, 0); }
+    void on_bool(Token t, bool) { add(t, Kind::boolean, 0); }
+
+    void on_uint(Token t, std::uint64_t value)
+    {
+        if (auto const path = add(t, Kind::integer, descriptor(t.type).fixed)) { schema.shape(*path).add_value(static_cast<double>(value)); }
+    }
+
+    void on_int(Token t, std::int64_t value)
+    {
+        if (auto const path = add(t, Kind::integer, descriptor(t.type).fixed)) { schema.shape(*path).add_value(static_cast<double>(value)); }
+    }
+
+    void on_float(Token t, double value)
+    {
+        auto const& d = descriptor(t.type);
+        if (auto const path = add(t, d.kind == msgscan::Kind::float32 ? Kind::float32 : Kind::float64, d.fixed)) { schema.shape(*path).add_value(value); }
+    }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        if (key())
+        {
+            auto& f = frames.back();
+            schema.shape(f.path).add_key(descriptor(t.type).size, length);
+            f.value = schema.value(f.path, data, length);
+            f.key = false;
+            return;
+        }
+        if (auto const path = add(t, Kind::str, length)) { schema.shape(*path).add_length(length); }
+    }
+
+    void on_bin(Token t, char const*, std::uint32_t length)
+    {
+        if (auto const path = add(t, Kind::bin, length)) { schema.shape(*path).add_length(length); }
+    }
+
+    void on_ext(Token t, std::int8_t, char const*, std::uint32_t length)
+    {
+        if (auto const path = add(t, Kind::ext, length)) { schema.shape(*path).add_length(length); }
+    }
+
+    bool begin_array(Token t, std::uint32_t count) { return begin(t, Kind::array, count); }
+    bool begin_map(Token t, std::uint32_t count) { return begin(t, Kind::map, count); }
+
+    void end_array(Token) { end(); }
+    void end_map(Token) { end(); }
+
+    // Blocks of records are not necessarily scanned in order; nothing of a record cut short
+    // carries over to the next one.
+    void on_truncated(Token t)
+    {
+        frames.clear();
+        key_depth = 0;
+        if (!truncated) { truncation = t.offset; }
+        truncated = true;
+    }
+
+    // Whether a record was cut short by the end of the input, and the offset of the first.
+    bool truncated = false;
+    std::uint64_t truncation = 0;
+
+private:
+    struct Frame
+    {
+        std::uint32_t path;
+        bool map;
+        bool key;            // The next element of a map is a key.
+        std::uint32_t value; // For a map, the path of the value of the key just seen.
+    };
+
+    bool key() const { return !frames.empty() && frames.back().map && frames.back().key; }
+
+    // Path of the object being reported, and moves past it.
+    std::uint32_t position()
+    {
+        if (frames.empty()) { return Schema::root; }
+
+        auto& f = frames.back();
+        if (!f.map) { return schema.element(f.path); }
+        f.key = true;
+        return f.value;
+    }
+
+    // Records an object of `kind` with `payload` bytes after its header; returns its path, or
+    // nothing for a map key or what is in one.
+    std::uint32_t const* add(Token t, Kind kind, std::uint64_t payload)
+    {
+        auto const header = descriptor(t.type).size;
+        if (key_depth)
+        {
+            schema.shape(key_owner).add_key_bytes(header, payload);
+            return nullptr;
+        }
+        if (key())
+        {
+            auto& f = frames.back();
+            schema.shape(f.path).add_key(header, payload);
+            f.value = schema.any_value(f.path);
+            f.key = false;
+            return nullptr;
+        }
+        current = position();
+        auto& shape = schema.shape(current);
+        shape.add(kind);
+        shape.add_bytes(kind, header, payload);
+        return &current;
+    }
+
+    bool begin(Token t, Kind kind, std::uint32_t count)
+    {
+        if (key_depth || key())
+        {
+            // A container as a key, or in one: the value goes under ".*", and what the key
+            // holds is only counted as key bytes of the map.
+            if (!key_depth) { key_owner = frames.back().path; }
+            add(t, kind, 0);
+            ++key_depth;
+            return true;
+        }
+
+        auto const path = *add(t, kind, 0);
+        schema.shape(path).add_length(count);
+        frames.push_back(Frame{path, kind == Kind::map, true, 0});
+        return true;
+    }
+
+    void end()
+    {
+        if (key_depth) { --key_depth; }
+        else { frames.pop_back(); }
+    }
+
+    Schema& schema;
+    std::vector<Frame> frames;
+    std::uint32_t current = 0;
+    std::uint32_t key_depth = 0; // Levels of nesting within a key.
+    std::uint32_t key_owner = 0; // Path of the map whose key that is.
+};
+
+
+// Infers the schema of the records in [begin, end), which start at records[0, count), into
+// `schema`, in one pass on up to `workers` threads.  The input is cut into blocks of whole
+// records, which workers take in turn, each adding to a schema of its own; those are merged
+// at the end.  `progress(consumed)` is called with the number of bytes done so far after each
+// block, from the worker threads but one at a time; returning false cancels the pass.
+// Returns false if cancelled.
+template <class Progress>
+bool infer_schema(char const* const begin, char const* const end, std::uint64_t const* const records, std::size_t const count, unsigned workers, Schema& schema, Progress&& progress)
+{
+    constexpr std::uint64_t block_size = std::uint64_t{4} << 20;
+
+    auto const size = static_cast<std::uint64_t>(end - begin);
+    auto const blocks = static_cast<std::size_t>((size + block_size - 1) / block_size);
+
+    auto const boundary = [&](std::size_t k)
+    {
+        auto const r = std::lower_bound(records, records + count, k * block_size);
+        return r != records + count ? *r : size;
+    };
+
+    auto const n = std::max(1u, std::min(workers, static_cast<unsigned>(std::min<std::size_t>(blocks, ~0u))));
+    std::vector<Schema> schemas(n);
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::uint64_t consumed = 0;
+
+    auto const work = [&](Schema& own)
+    {
+        SchemaVisitor visitor{own};
+        std::size_t k;
+        while ((k = next.fetch_add(1, std::memory_order_relaxed)) < blocks && !cancelled.load(std::memory_order_relaxed))
+        {
+            auto const from = boundary(k);
+            auto const to = std::max(from, boundary(k + 1));
+            scan(begin + from, begin + to, visitor);
+
+            std::lock_guard<std::mutex> lock{mutex};
+            consumed += std::min(size, (k + 1) * block_size) - std::min(size, k * block_size);
+            if (!progress(consumed)) { cancelled = true; }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(n - 1);
+    for (unsigned i = 1; i != n; ++i)
+    {
+        threads.emplace_back(work, std::ref(schemas[i]));
+    }
+    work(schemas[0]);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    if (cancelled) { return false; }
+    for (auto const& s : schemas)
+    {
+        schema.merge(s);
+    }
+    return true;
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_SCHEMA_HPP
@@ -0,0 +1,160 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_SEARCH_HPP
+#define MSGSCAN_SEARCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "msgscan/format.hpp"
+#include "msgscan/visitor.hpp"
+#include "msgscan/text.hpp"
+#include "msgscan/query.hpp"
+
+
+namespace msgscan
+{
+
+// What to look for: strs (map keys as well as values) containing `text`, and, if
+// `match_number`, integers equal to `number`.
+struct Query
+{
+    std::string text;
+    bool match_number = false;
+    std::int64_t number = 0;
+};
+
+// Collects the offsets of the objects matching a query, `base` being added to those reported.
+struct SearchVisitor final : BasicVisitor
+{
+    SearchVisitor(Query const& query, std::uint64_t base, std::vector<std::uint64_t>& hits)
+      : query(query), base{base}, hits(hits) { }
+
+    void on_str(Token t, char const* data, std::uint32_t length)
+    {
+        if (!query.text.empty() && find(data, length, query.text.data(), query.text.size())) { hits.push_back(base + t.offset); }
+    }
+
+    void on_uint(Token t, std::uint64_t value)
+    {
+        if (query.match_number && query.number >= 0 && value == static_cast<std::uint64_t>(query.number)) { hits.push_back(base + t.offset); }
+    }
+
+    void on_int(Token t, std::int64_t value)
+    {
+        if (query.match_number && value == query.number) { hits.push_back(base + t.offset); }
+    }
+
+    Query const& query;
+    std::uint64_t const base;
+    std::vector<std::uint64_t>& hits;
+};
+
+
+// Appends the offsets of the matches in [begin, end), a run of whole records starting at
+// `base`, to `hits`.
+inline void find_matches(char const* begin, char const* end, std::uint64_t base, Query const& query, std::vector<std::uint64_t>& hits)
+{
+    SearchVisitor visitor{query, base, hits};
+    scan(begin, end, visitor);
+}
+
+inline void find_matches(char const* begin, char const* end, std::uint64_t base, PathQuery const& query, std::vector<std::uint64_t>& hits)
+{
+    auto visitor = make_query_visitor(query, base, [&](std::uint64_t offset) { hits.push_back(offset); });
+    scan(begin, end, visitor);
+}
+
+
+// Searches the records in [begin, end), which start at records[0, count), for a Query or a
+// PathQuery on up to `workers` threads.  The input is cut into blocks of whole records, which
+// workers take in turn.
+// `found(hits, consumed)` is called from the calling thread with the offsets of the matches of
+// each block, in file order, and the number of bytes searched so far; returning false cancels
+// the search.  Returns false if cancelled.
+template <class Q, class Found>
+bool search(char const* const begin, char const* const end, std::uint64_t const* const records, std::size_t const count, Q const& query, unsigned workers, Found&& found)
+{
+    constexpr std::uint64_t block_size = std::uint64_t{4} << 20;
+
+    auto const size = static_cast<std::uint64_t>(end - begin);
+    auto const blocks = static_cast<std::size_t>((size + block_size - 1) / block_size);
+
+    // The records starting in a block, from the block's first one to the next block's.
+    auto const boundary = [&](std::size_t k)
+    {
+        auto const r = std::lower_bound(records, records + count, k * block_size);
+        return r != records + count ? *r : size;
+    };
+
+    std::vector<std::vector<std::uint64_t>> results(blocks);
+    std::vector<char> done(blocks);
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> cancelled{false};
+
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    auto const work = [&]
+    {
+        std::size_t k;
+        while ((k = next.fetch_add(1, std::memory_order_relaxed)) < blocks && !cancelled.load(std::memory_order_relaxed))
+        {
+            std::vector<std::uint64_t> hits;
+            auto const from = boundary(k);
+            auto const to = std::max(from, boundary(k + 1));
+
+            find_matches(begin + from, begin + to, from, query, hits);
+
+            std::lock_guard<std::mutex> lock{mutex};
+            results[k] = std::move(hits);
+            done[k] = true;
+            finished.notify_one();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    auto const n = std::max(1u, std::min(workers, static_cast<unsigned>(std::min<std::size_t>(blocks, ~0u))));
+    threads.reserve(n);
+    for (unsigned i = 0; i != n; ++i)
+    {
+        threads.emplace_back(work);
+    }
+
+    // Hand the results over in order, as soon as all blocks before them are done.
+    auto ok = true;
+    for (std::size_t k = 0; k != blocks && ok; ++k)
+    {
+        std::vector<std::uint64_t> hits;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            finished.wait(lock, [&] { return done[k] != 0; });
+            hits = std::move(results[k]);
+        }
+        if (!found(hits, std::min(size, (k + 1) * block_size)))
+        {
+            ok = false;
+            cancelled = true;
+        }
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    return ok;
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_SEARCH_HPP
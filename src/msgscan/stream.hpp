@@ -0,0 +1,76 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_STREAM_HPP
+#define MSGSCAN_STREAM_HPP
+
+#include <cstdint>
+
+#include "msgscan/format.hpp"
+
+
+namespace msgscan
+{
+
+// Finds where the records (top-level objects) of a stream end, while the stream arrives in
+// pieces of any size.  The caller keeps the bytes received so far contiguous and hands them
+// all to split() after each piece; the splitter carries on where it stopped.  Each header is
+// read once, or again only if it was cut short, and payloads are not read at all.
+//
+// Offsets are relative to the start of the bytes passed in.  When the caller drops bytes from
+// the front, rebase() shifts the splitter's own offsets to match.
+class RecordSplitter
+{
+public:
+    // Calls on_record(start, end) for every record completed in [begin, end).
+    template <class F>
+    void split(char const* const begin, char const* const end, F&& on_record)
+    {
+        auto const size = static_cast<std::uint64_t>(end - begin);
+        for (;;)
+        {
+            if (open && pending == 0 && next <= size)
+            {
+                on_record(start, next);
+                open = false;
+            }
+            if (next >= size) { return; }
+
+            Header h;
+            if (!read_header(begin + next, end, h)) { return; }
+
+            if (!open)
+            {
+                start = next;
+                pending = 1;
+                open = true;
+            }
+
+            // May point past the bytes received so far, until the payload has arrived.
+            next += h.size + h.payload;
+            pending += h.count - 1;
+        }
+    }
+
+    // Offset of the record that has not been completed yet, if any.  A stream that ends here
+    // is truncated if this is less than its size.
+    std::uint64_t unfinished() const noexcept { return open ? start : next; }
+
+    void rebase(std::uint64_t shift) noexcept
+    {
+        start -= shift;
+        next -= shift;
+    }
+
+private:
+    std::uint64_t start = 0;   // Of the record being read, if `open`.
+    std::uint64_t next = 0;    // Of the next header to read.
+    std::uint64_t pending = 0; // Objects of the open record not read yet.
+    bool open = false;
+};
+
+} // namespace msgscan
+
+#endif // MSGSCAN_STREAM_HPP
@@ -0,0 +1,110 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_STRUCTURE_HPP
+#define MSGSCAN_STRUCTURE_HPP
+
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "msgscan/format.hpp"
+
+
+namespace msgscan
+{
+
+// End offset and subtree size of a map or array, from the structure pass.  Extents are in
+// file (pre-)order, so the next container after the subtree of extent `i` is extent
+// `i + 1 + containers`.
+struct Extent
+{
+    std::uint64_t offset;     // Of the type byte.
+    std::uint64_t end;        // One past the last byte of the container.
+    std::uint64_t elements;   // Objects nested in it, at any depth.
+    std::uint64_t containers; // Non-empty maps and arrays nested in it, at any depth.
+    bool truncated;           // Cut short by the end of the input; `end` is the input's end.
+};
+
+
+// Records the extent of every non-empty map and array in [begin, end), in one pass over the
+// headers.  The pass stops at the first object cut short by `end`.  `progress(consumed)` is
+// called with the number of bytes consumed so far, roughly every thousandth of the input;
+// returning false cancels the pass.
+template <class Progress>
+bool build_structure(char const* const begin, char const* const end, std::vector<Extent>& extents, Progress&& progress)
+{
+    auto const report_step = std::max<std::ptrdiff_t>((end - begin) / 1000, 1 << 20);
+    auto next_report = begin + std::min(report_step, end - begin);
+
+    // Open containers: their extent, the elements still to come, and the object count when opened.
+    struct Frame { std::size_t extent; std::uint64_t remaining, objects; };
+    std::vector<Frame> ctx;
+    std::uint64_t objects = 0;
+
+    auto const close = [&](char const* p, bool truncated)
+    {
+        auto const& f = ctx.back();
+        auto& e = extents[f.extent];
+        e.end = static_cast<std::uint64_t>(p - begin);
+        e.elements = objects - f.objects;
+        e.containers = extents.size() - f.extent - 1;
+        e.truncated = truncated;
+        ctx.pop_back();
+    };
+
+    for (auto p = begin; p < end; )
+    {
+        if (p >= next_report)
+        {
+            if (!progress(p - begin)) { return false; }
+            next_report = p + std::min(report_step, end - p);
+        }
+
+        auto const offset = static_cast<std::uint64_t>(p - begin);
+
+        Header h;
+        if (!read_header(p, end, h) || !fits(h, p, end)) { break; }
+        p += h.size + h.payload;
+
+        if (h.count)
+        {
+            ctx.push_back(Frame{extents.size(), h.count, ++objects});
+            extents.push_back(Extent{offset, 0, 0, 0, false});
+            continue;
+        }
+
+        ++objects;
+        while (!ctx.empty() && --ctx.back().remaining == 0)
+        {
+            close(p, false);
+        }
+    }
+
+    // Containers cut short by the end of the input.
+    while (!ctx.empty())
+    {
+        close(end, true);
+    }
+    return true;
+}
+
+// Extent of the container at `offset` among the sorted [first, last), or nullptr if there is
+// none.
+inline Extent const* find_extent(Extent const* first, Extent const* last, std::uint64_t offset)
+{
+    auto const itr = std::lower_bound(first, last, offset, [](Extent const& e, std::uint64_t offset) { return e.offset < offset; });
+    return itr != last && itr->offset == offset ? itr : nullptr;
+}
+
+inline Extent const* find_extent(std::vector<Extent> const& extents, std::uint64_t offset)
+{
+    return find_extent(extents.data(), extents.data() + extents.size(), offset);
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_STRUCTURE_HPP
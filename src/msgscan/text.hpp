@@ -0,0 +1,357 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_TEXT_HPP
+#define MSGSCAN_TEXT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "msgscan/config.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if MSGSCAN_SSE2
+#include <emmintrin.h>
+#endif
+#if MSGSCAN_AVX2
+#include <immintrin.h>
+#endif
+
+
+// Searching and validating str payloads where they lie in the input, without converting them.
+// Each kernel has a scalar version and, on x86, SSE2 and AVX2 ones; the widest the CPU
+// supports is chosen at run time.
+namespace msgscan
+{
+
+namespace detail
+{
+
+// Of a non-zero `x`.
+MSGSCAN_FORCEINLINE unsigned count_trailing_zeros(std::uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctz(x));
+#endif
+}
+
+// Candidates are found a byte at a time by memchr on the needle's first byte.
+inline char const* find_scalar(char const* data, std::size_t length, char const* needle, std::size_t n)
+{
+    auto const last = data + (length - n);
+    for (auto p = data; p <= last; ++p)
+    {
+        p = static_cast<char const*>(std::memchr(p, needle[0], static_cast<std::size_t>(last - p) + 1));
+        if (!p) { return nullptr; }
+        if (std::memcmp(p + 1, needle + 1, n - 1) == 0) { return p; }
+    }
+    return nullptr;
+}
+
+// Advances `p` past the UTF-8 sequence there, if it is a valid one: no overlong forms, no
+// surrogates, nothing past U+10FFFF.
+inline bool utf8_sequence(unsigned char const*& p, unsigned char const* const end)
+{
+    auto const c = *p;
+    if (c < 0x80u)
+    {
+        ++p;
+        return true;
+    }
+
+    std::size_t n;
+    unsigned char low = 0x80u, high = 0xbfu; // Bounds of the second byte.
+    if (c < 0xc2u) { return false; }
+    else if (c < 0xe0u) { n = 2; }
+    else if (c < 0xf0u)
+    {
+        n = 3;
+        if (c == 0xe0u) { low = 0xa0u; }
+        if (c == 0xedu) { high = 0x9fu; }
+    }
+    else if (c < 0xf5u)
+    {
+        n = 4;
+        if (c == 0xf0u) { low = 0x90u; }
+        if (c == 0xf4u) { high = 0x8fu; }
+    }
+    else { return false; }
+
+    if (static_cast<std::size_t>(end - p) < n) { return false; }
+    if (p[1] < low || p[1] > high) { return false; }
+    for (std::size_t i = 2; i < n; ++i)
+    {
+        if ((p[i] & 0xc0u) != 0x80u) { return false; }
+    }
+    p += n;
+    return true;
+}
+
+// ASCII is skipped eight bytes at a time.
+inline bool valid_utf8_scalar(char const* data, std::size_t length)
+{
+    auto p = reinterpret_cast<unsigned char const*>(data);
+    auto const end = p + length;
+    while (p < end)
+    {
+        std::uint64_t word;
+        if (end - p >= 8 && (std::memcpy(&word, p, 8), (word & 0x8080808080808080u) == 0))
+        {
+            p += 8;
+            continue;
+        }
+        if (!utf8_sequence(p, end)) { return false; }
+    }
+    return true;
+}
+
+#if MSGSCAN_SSE2
+
+// Compares the needle's first and last bytes at 16 positions at once; only positions where
+// both match are compared in full.
+inline char const* find_sse2(char const* data, std::size_t length, char const* needle, std::size_t n)
+{
+    auto const first = _mm_set1_epi8(needle[0]);
+    auto const last = _mm_set1_epi8(needle[n - 1]);
+
+    std::size_t i = 0;
+    for (; i + 16 + n - 1 <= length; i += 16)
+    {
+        auto const head = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+        auto const tail = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + n - 1));
+        auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+        for (; mask; mask &= mask - 1)
+        {
+            auto const p = data + i + count_trailing_zeros(mask);
+            if (std::memcmp(p + 1, needle + 1, n - 2) == 0) { return p; }
+        }
+    }
+    return length - i >= n ? find_scalar(data + i, length - i, needle, n) : nullptr;
+}
+
+// ASCII is skipped sixteen bytes at a time.
+inline bool valid_utf8_sse2(char const* data, std::size_t length)
+{
+    auto p = reinterpret_cast<unsigned char const*>(data);
+    auto const end = p + length;
+    while (p < end)
+    {
+        if (end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p))) == 0)
+        {
+            p += 16;
+            continue;
+        }
+        if (!utf8_sequence(p, end)) { return false; }
+    }
+    return true;
+}
+
+#endif // MSGSCAN_SSE2
+
+#if MSGSCAN_AVX2
+
+inline bool has_avx2()
+{
+    static bool const supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+MSGSCAN_TARGET_AVX2 inline char const* find_avx2(char const* data, std::size_t length, char const* needle, std::size_t n)
+{
+    auto const first = _mm256_set1_epi8(needle[0]);
+    auto const last = _mm256_set1_epi8(needle[n - 1]);
+
+    std::size_t i = 0;
+    for (; i + 32 + n - 1 <= length; i += 32)
+    {
+        auto const head = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+        auto const tail = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i + n - 1));
+        auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+        for (; mask; mask &= mask - 1)
+        {
+            auto const p = data + i + count_trailing_zeros(mask);
+            if (std::memcmp(p + 1, needle + 1, n - 2) == 0) { return p; }
+        }
+    }
+    return length - i >= n ? find_scalar(data + i, length - i, needle, n) : nullptr;
+}
+
+// UTF-8 validation by table lookup (Keiser and Lemire, "Validating UTF-8 in less than one
+// instruction per byte", 2021).  Each pair of adjacent bytes is classified by three 16-entry
+// tables, indexed by the high and low nibbles of the first byte and the high nibble of the
+// second; a bit set in all three is an error.  The continuation bytes of three- and four-byte
+// sequences are checked separately, against the lead bytes two and three places back.
+
+MSGSCAN_TARGET_AVX2 inline __m256i table16(std::uint8_t const (&t)[16])
+{
+    auto const lane = _mm_loadu_si128(reinterpret_cast<__m128i const*>(t));
+    return _mm256_broadcastsi128_si256(lane);
+}
+
+// The input moved `n` bytes later, the first `n` bytes coming from the end of `prev`.
+#define MSGSCAN_UTF8_PREV(input, prev, n) \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+MSGSCAN_TARGET_AVX2 inline __m256i utf8_errors(__m256i input, __m256i prev)
+{
+    constexpr std::uint8_t too_short = 1u << 0;  // Lead byte not followed by a continuation.
+    constexpr std::uint8_t too_long = 1u << 1;   // Continuation after ASCII.
+    constexpr std::uint8_t overlong_3 = 1u << 2;
+    constexpr std::uint8_t too_large = 1u << 3;
+    constexpr std::uint8_t surrogate = 1u << 4;
+    constexpr std::uint8_t overlong_2 = 1u << 5;
+    constexpr std::uint8_t too_large_1000 = 1u << 6;
+    constexpr std::uint8_t overlong_4 = 1u << 6;
+    constexpr std::uint8_t two_conts = 1u << 7;  // Continuation after continuation.
+    constexpr std::uint8_t carry = too_short | too_long | two_conts;
+
+    static std::uint8_t const byte_1_high[16] =
+    {
+        too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2,
+        too_short,
+        too_short | overlong_3 | surrogate,
+        too_short | too_large | too_large_1000 | overlong_4,
+    };
+    static std::uint8_t const byte_1_low[16] =
+    {
+        carry | overlong_3 | overlong_2 | overlong_4,
+        carry | overlong_2,
+        carry,
+        carry,
+        carry | too_large,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000 | surrogate,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+    };
+    static std::uint8_t const byte_2_high[16] =
+    {
+        too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_short, too_short, too_short, too_short,
+    };
+
+    auto const nibble = _mm256_set1_epi8(0x0f);
+    auto const prev1 = MSGSCAN_UTF8_PREV(input, prev, 1);
+    auto const prev1_high = _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble);
+    auto const prev1_low = _mm256_and_si256(prev1, nibble);
+    auto const input_high = _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble);
+
+    auto const special = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(table16(byte_1_high), prev1_high), _mm256_shuffle_epi8(table16(byte_1_low), prev1_low)),
+        _mm256_shuffle_epi8(table16(byte_2_high), input_high));
+
+    // Bytes two after a three- or four-byte lead, or three after a four-byte lead, must be
+    // continuations; two_conts is expected exactly there.
+    auto const prev2 = MSGSCAN_UTF8_PREV(input, prev, 2);
+    auto const prev3 = MSGSCAN_UTF8_PREV(input, prev, 3);
+    auto const third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xe0u - 0x80u)));
+    auto const fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xf0u - 0x80u)));
+    auto const must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80u)));
+
+    return _mm256_xor_si256(must_continue, special);
+}
+
+#undef MSGSCAN_UTF8_PREV
+
+MSGSCAN_TARGET_AVX2 inline bool valid_utf8_avx2(char const* data, std::size_t length)
+{
+    // A sequence still open at the end of a block: a lead byte in its last three bytes that
+    // needs more bytes than remain.
+    static std::uint8_t const incomplete_bounds[32] =
+    {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xf0 - 1, 0xe0 - 1, 0xc0 - 1,
+    };
+    auto const bounds = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(incomplete_bounds));
+
+    auto error = _mm256_setzero_si256();
+    auto prev = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        auto const input = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+        if (_mm256_movemask_epi8(input) == 0)
+        {
+            // All ASCII: only a sequence left open by the block before can be wrong.
+            error = _mm256_or_si256(error, _mm256_subs_epu8(prev, bounds));
+        }
+        else
+        {
+            error = _mm256_or_si256(error, utf8_errors(input, prev));
+        }
+        prev = input;
+    }
+
+    // The rest, padded with ASCII, which also catches a sequence the input ends in the middle of.
+    alignas(32) char rest[32] = {};
+    std::memcpy(rest, data + i, length - i);
+    error = _mm256_or_si256(error, utf8_errors(_mm256_load_si256(reinterpret_cast<__m256i const*>(rest)), prev));
+
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif // MSGSCAN_AVX2
+
+} // namespace detail
+
+
+// First occurrence of [needle, needle + n) in [data, data + length), or nullptr.  An empty
+// needle is found at `data`.
+inline char const* find(char const* data, std::size_t length, char const* needle, std::size_t n)
+{
+    if (n == 0) { return data; }
+    if (length < n) { return nullptr; }
+    if (n == 1) { return static_cast<char const*>(std::memchr(data, needle[0], length)); }
+
+#if MSGSCAN_AVX2
+    if (detail::has_avx2()) { return detail::find_avx2(data, length, needle, n); }
+#endif
+#if MSGSCAN_SSE2
+    return detail::find_sse2(data, length, needle, n);
+#else
+    return detail::find_scalar(data, length, needle, n);
+#endif
+}
+
+// Whether [data, data + length) is well-formed UTF-8.
+inline bool valid_utf8(char const* data, std::size_t length)
+{
+    // Below a block, setting up the vector kernels costs more than they save.
+    if (length < 32) { return detail::valid_utf8_scalar(data, length); }
+
+#if MSGSCAN_AVX2
+    if (detail::has_avx2()) { return detail::valid_utf8_avx2(data, length); }
+#endif
+#if MSGSCAN_SSE2
+    return detail::valid_utf8_sse2(data, length);
+#else
+    return detail::valid_utf8_scalar(data, length);
+#endif
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_TEXT_HPP
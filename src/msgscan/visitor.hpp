@@ -0,0 +1,229 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGSCAN_VISITOR_HPP
+#define MSGSCAN_VISITOR_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "msgscan/config.hpp"
+#include "msgscan/format.hpp"
+
+
+namespace msgscan
+{
+
+// Where an object was found: the offset of its type byte in the input, and that byte.
+struct Token
+{
+    std::uint64_t offset;
+    std::uint8_t type;
+};
+
+
+// Events of a scan, all no-ops.  A visitor derives from this and hides the events it is
+// interested in; scan() and visit() are templates on the visitor type, so each event is a
+// direct (usually inlined) call rather than a virtual one.
+//
+// Returning false from begin_array/begin_map skips the container's elements; end_array and
+// end_map are reported only for containers that were entered.  Maps report their entries as
+// alternating keys and values.  An object running past the end of the input is reported by
+// on_truncated instead, and ends the scan; so does a container missing elements at the end.
+struct BasicVisitor
+{
+    void on_nil(Token) { }
+    void on_never_used(Token) { }
+    void on_bool(Token, bool) { }
+    void on_uint(Token, std::uint64_t) { }
+    void on_int(Token, std::int64_t) { }
+    void on_float(Token, double) { }
+    void on_str(Token, char const*, std::uint32_t) { }
+    void on_bin(Token, char const*, std::uint32_t) { }
+    void on_ext(Token, std::int8_t, char const*, std::uint32_t) { }
+    bool begin_array(Token, std::uint32_t) { return true; }
+    void end_array(Token) { }
+    bool begin_map(Token, std::uint32_t) { return true; }
+    void end_map(Token) { }
+    void on_truncated(Token) { }
+};
+
+
+// Reports the object at `p` (found at `offset`), whose type byte is described by `d` and whose
+// header is `h`, to `visitor`, without descending into it.  The object must fit in the input.
+// Returns true if it is a map or array that the visitor chose to enter.
+template <class Visitor>
+MSGSCAN_FORCEINLINE bool visit(Descriptor const& d, Header const& h, char const* p, std::uint64_t offset, Visitor& visitor)
+{
+    auto const byte = static_cast<unsigned char>(*p);
+    auto const token = Token{offset, byte};
+    auto const length = d.arity ? h.count / d.arity : h.payload;
+    auto const body = p + d.size;
+
+    switch (d.kind)
+    {
+    case Kind::nil:
+        visitor.on_nil(token);
+        return false;
+    case Kind::never_used:
+        visitor.on_never_used(token);
+        return false;
+    case Kind::boolean:
+        visitor.on_bool(token, (byte & 1u) != 0);
+        return false;
+    case Kind::positive_fixint:
+        visitor.on_uint(token, byte);
+        return false;
+    case Kind::negative_fixint:
+        visitor.on_int(token, static_cast<std::int8_t>(byte));
+        return false;
+    case Kind::uint:
+        switch (length)
+        {
+        case 1: visitor.on_uint(token, *reinterpret_cast<std::uint8_t const*>(body)); break;
+        case 2: visitor.on_uint(token, loadbe16(body)); break;
+        case 4: visitor.on_uint(token, loadbe32(body)); break;
+        default: visitor.on_uint(token, loadbe64(body)); break;
+        }
+        return false;
+    case Kind::int_:
+        switch (length)
+        {
+        case 1: visitor.on_int(token, *reinterpret_cast<std::int8_t const*>(body)); break;
+        case 2: visitor.on_int(token, static_cast<std::int16_t>(loadbe16(body))); break;
+        case 4: visitor.on_int(token, static_cast<std::int32_t>(loadbe32(body))); break;
+        default: visitor.on_int(token, static_cast<std::int64_t>(loadbe64(body))); break;
+        }
+        return false;
+    case Kind::float32:
+      {
+        union { std::uint32_t i; float f; } value = {loadbe32(body)};
+        visitor.on_float(token, value.f);
+      }
+        return false;
+    case Kind::float64:
+      {
+        union { std::uint64_t i; double d; } value = {loadbe64(body)};
+        visitor.on_float(token, value.d);
+      }
+        return false;
+    case Kind::str:
+        visitor.on_str(token, body, static_cast<std::uint32_t>(length));
+        return false;
+    case Kind::bin:
+        visitor.on_bin(token, body, static_cast<std::uint32_t>(length));
+        return false;
+    case Kind::ext:
+        visitor.on_ext(token, *reinterpret_cast<std::int8_t const*>(body - 1), body, static_cast<std::uint32_t>(length));
+        return false;
+    case Kind::array:
+        return visitor.begin_array(token, static_cast<std::uint32_t>(length));
+    case Kind::map:
+        return visitor.begin_map(token, static_cast<std::uint32_t>(length));
+    }
+    __builtin_unreachable();
+}
+
+// Reports the object at `p` (found at `offset`) to `visitor`, without descending into it.
+// Returns true if it is a map or array that the visitor chose to enter.  If the object runs
+// past `end`, it is reported by on_truncated; with the never-used type byte 0xc1 if not even
+// its type byte is there.
+template <class Visitor>
+bool visit(char const* p, char const* const end, std::uint64_t offset, Visitor& visitor)
+{
+    Header h;
+    if (!read_header(p, end, h) || !fits(h, p, end))
+    {
+        visitor.on_truncated(Token{offset, p < end ? static_cast<std::uint8_t>(*p) : std::uint8_t{0xc1}});
+        return false;
+    }
+    return visit(descriptor(static_cast<unsigned char>(*p)), h, p, offset, visitor);
+}
+
+
+// Reports every object in [begin, end) to `visitor`, depth first.  The input is a sequence of
+// top-level objects.  Returns where scanning stopped: `end`, or the start of a truncated object.
+template <class Visitor>
+char const* scan(char const* const begin, char const* const end, Visitor& visitor)
+{
+    // Open containers, with their elements still to come.
+    struct Frame { Token token; std::uint64_t remaining; };
+    std::vector<Frame> ctx;
+
+    auto const close = [&](Token token)
+    {
+        if (is_map(token.type))
+        {
+            visitor.end_map(token);
+        }
+        else
+        {
+            visitor.end_array(token);
+        }
+    };
+
+    auto p = begin;
+    while (p < end)
+    {
+        auto const token = Token{static_cast<std::uint64_t>(p - begin), static_cast<std::uint8_t>(*p)};
+        auto const& d = descriptor(token.type);
+
+        Header h;
+        if (end - p >= unchecked_margin)
+        {
+            h = read_header(d, p);
+        }
+        else if (!read_header(p, end, h))
+        {
+            visitor.on_truncated(token);
+            return p;
+        }
+        if (!fits(h, p, end))
+        {
+            visitor.on_truncated(token);
+            return p;
+        }
+
+        auto const entered = visit(d, h, p, token.offset, visitor);
+        p += h.size + h.payload;
+
+        if (entered && h.count)
+        {
+            ctx.push_back(Frame{token, h.count});
+            continue;
+        }
+
+        if (entered)
+        {
+            close(token);
+        }
+        else if (h.count)
+        {
+            auto const start = p;
+            if (skip(p, end, h.count))
+            {
+                visitor.on_truncated(token);
+                return start;
+            }
+        }
+
+        while (!ctx.empty() && --ctx.back().remaining == 0)
+        {
+            auto const closed = ctx.back().token;
+            ctx.pop_back();
+            close(closed);
+        }
+    }
+
+    if (!ctx.empty())
+    {
+        visitor.on_truncated(ctx.back().token);
+    }
+    return p;
+}
+
+} // namespace msgscan
+
+#endif // MSGSCAN_VISITOR_HPP
@@ -0,0 +1,102 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef MSGVIEWER_STRING_POOL_HPP
+#define MSGVIEWER_STRING_POOL_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <QString>
+
+
+// Hash-consed dictionary of short strs.  Map keys and enumeration-like values recur over and
+// over; each distinct text is decoded once, and every occurrence refers to it by a small id,
+// so equal texts have equal ids and share one QString.  Long or too many distinct texts are
+// not kept, which bounds the pool for unique data.
+class StringPool final
+{
+public:
+    static constexpr std::uint32_t max_length = 64;
+    static constexpr std::uint32_t max_strings = 1 << 14;
+    static constexpr std::uint32_t none = ~std::uint32_t{};
+
+    // Id of the text, added if new; none if it is not kept.
+    std::uint32_t intern(char const* data, std::uint64_t length);
+
+    // The text, shared with the pool: copying a QString only takes a reference, and what is
+    // returned may outlive the model and its pool in QVariants the view keeps.
+    QString text(std::uint32_t id) const { return entries[id].text; }
+
+private:
+    struct Entry
+    {
+        std::uint32_t offset; // In `bytes`.
+        std::uint32_t length;
+        std::uint32_t hash;
+        QString text; // Decoded once, when interned.
+    };
+
+    static std::uint32_t hash(char const* data, std::uint32_t length) noexcept
+    {
+        // FNV-1a.
+        std::uint32_t h = 2166136261u;
+        for (std::uint32_t i = 0; i != length; ++i)
+        {
+            h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    void rehash(std::size_t size);
+
+    std::vector<char> bytes;
+    std::vector<Entry> entries;
+    std::vector<std::uint32_t> table; // Open addressing, id + 1 or 0; at most half full.
+};
+
+
+inline std::uint32_t StringPool::intern(char const* data, std::uint64_t length)
+{
+    if (length > max_length) { return none; }
+
+    auto const n = static_cast<std::uint32_t>(length);
+    auto const h = hash(data, n);
+    if (table.empty()) { rehash(1024); }
+
+    auto const mask = table.size() - 1;
+    auto i = h & mask;
+    for (; table[i]; i = (i + 1) & mask)
+    {
+        auto const& e = entries[table[i] - 1];
+        if (e.hash == h && e.length == n && std::memcmp(bytes.data() + e.offset, data, n) == 0) { return table[i] - 1; }
+    }
+
+    if (entries.size() == max_strings) { return none; }
+
+    auto const id = static_cast<std::uint32_t>(entries.size());
+    entries.push_back(Entry{static_cast<std::uint32_t>(bytes.size()), n, h, QString::fromUtf8(data, static_cast<int>(n))});
+    bytes.insert(bytes.end(), data, data + n);
+    table[i] = id + 1;
+
+    if (entries.size() * 2 > table.size()) { rehash(table.size() * 2); }
+    return id;
+}
+
+inline void StringPool::rehash(std::size_t size)
+{
+    table.assign(size, 0);
+
+    auto const mask = size - 1;
+    for (std::uint32_t id = 0; id != entries.size(); ++id)
+    {
+        auto i = entries[id].hash & mask;
+        while (table[i]) { i = (i + 1) & mask; }
+        table[i] = id + 1;
+    }
+}
+
+#endif // MSGVIEWER_STRING_POOL_HPP
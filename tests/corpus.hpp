@@ -0,0 +1,234 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Encoding of test inputs, random records, and checks, shared by the msgscan tests.
+
+#ifndef MSGVIEWER_TESTS_CORPUS_HPP
+#define MSGVIEWER_TESTS_CORPUS_HPP
+
+#include <random>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+namespace corpus
+{
+
+// Failed checks so far; a test's exit status.
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void check(bool ok, char const* what, char const* detail = "")
+{
+    if (ok) { return; }
+
+    ++failures();
+    std::fprintf(stderr, "FAILED: %s %s\n", what, detail);
+}
+
+
+inline void put_be(std::string& out, std::uint64_t value, int bytes)
+{
+    while (bytes--)
+    {
+        out.push_back(static_cast<char>(value >> (bytes * 8)));
+    }
+}
+
+// Header of a str, bin, array or map of `length` in the smallest encoding; `fix` is the type
+// byte of the fix form with length 0, or 0 if there is none.
+inline void put_header(std::string& out, std::uint64_t length, unsigned fix, std::uint64_t fix_max, unsigned type8, unsigned type16, unsigned type32)
+{
+    if (fix && length <= fix_max)
+    {
+        out.push_back(static_cast<char>(fix | length));
+    }
+    else if (type8 && length <= 0xff)
+    {
+        out.push_back(static_cast<char>(type8));
+        put_be(out, length, 1);
+    }
+    else if (length <= 0xffff)
+    {
+        out.push_back(static_cast<char>(type16));
+        put_be(out, length, 2);
+    }
+    else
+    {
+        out.push_back(static_cast<char>(type32));
+        put_be(out, length, 4);
+    }
+}
+
+inline void put_nil(std::string& out) { out.push_back('\xc0'); }
+inline void put_bool(std::string& out, bool value) { out.push_back(value ? '\xc3' : '\xc2'); }
+inline void put_array(std::string& out, std::uint64_t count) { put_header(out, count, 0x90, 15, 0, 0xdc, 0xdd); }
+inline void put_map(std::string& out, std::uint64_t count) { put_header(out, count, 0x80, 15, 0, 0xde, 0xdf); }
+
+inline void put_str(std::string& out, char const* data, std::size_t length)
+{
+    put_header(out, length, 0xa0, 31, 0xd9, 0xda, 0xdb);
+    out.append(data, length);
+}
+
+inline void put_str(std::string& out, std::string const& s) { put_str(out, s.data(), s.size()); }
+
+inline void put_bin(std::string& out, char const* data, std::size_t length)
+{
+    put_header(out, length, 0, 0, 0xc4, 0xc5, 0xc6);
+    out.append(data, length);
+}
+
+inline void put_uint(std::string& out, std::uint64_t value)
+{
+    if (value < 0x80) { out.push_back(static_cast<char>(value)); }
+    else if (value <= 0xff) { out.push_back('\xcc'); put_be(out, value, 1); }
+    else if (value <= 0xffff) { out.push_back('\xcd'); put_be(out, value, 2); }
+    else if (value <= 0xffffffff) { out.push_back('\xce'); put_be(out, value, 4); }
+    else { out.push_back('\xcf'); put_be(out, value, 8); }
+}
+
+inline void put_int(std::string& out, std::int64_t value)
+{
+    if (value >= 0) { put_uint(out, static_cast<std::uint64_t>(value)); }
+    else if (value >= -32) { out.push_back(static_cast<char>(value)); }
+    else if (value >= -0x80) { out.push_back('\xd0'); put_be(out, static_cast<std::uint64_t>(value), 1); }
+    else if (value >= -0x8000) { out.push_back('\xd1'); put_be(out, static_cast<std::uint64_t>(value), 2); }
+    else if (value >= -0x80000000ll) { out.push_back('\xd2'); put_be(out, static_cast<std::uint64_t>(value), 4); }
+    else { out.push_back('\xd3'); put_be(out, static_cast<std::uint64_t>(value), 8); }
+}
+
+inline void put_float32(std::string& out, float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    out.push_back('\xca');
+    put_be(out, bits, 4);
+}
+
+inline void put_float64(std::string& out, double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    out.push_back('\xcb');
+    put_be(out, bits, 8);
+}
+
+inline void put_ext(std::string& out, std::int8_t type, char const* data, std::size_t length)
+{
+    switch (length)
+    {
+    case 1: out.push_back('\xd4'); break;
+    case 2: out.push_back('\xd5'); break;
+    case 4: out.push_back('\xd6'); break;
+    case 8: out.push_back('\xd7'); break;
+    case 16: out.push_back('\xd8'); break;
+    default: put_header(out, length, 0, 0, 0xc7, 0xc8, 0xc9); break;
+    }
+    out.push_back(static_cast<char>(type));
+    out.append(data, length);
+}
+
+
+// Random records of every type, nested a few levels: maps with a few recurring keys (some not
+// plain names), and now and then a key that is not a str, a container as a key, or a "wide"
+// map keyed by ids drawn from many more than a schema keeps apart.
+class Generator
+{
+public:
+    explicit Generator(std::uint64_t seed) : random{seed} { }
+
+    // Records until there are at least `bytes`.
+    std::string records(std::size_t bytes)
+    {
+        std::string out;
+        out.reserve(bytes + 4096);
+        while (out.size() < bytes)
+        {
+            object(out, 0);
+        }
+        return out;
+    }
+
+    void object(std::string& out, int depth)
+    {
+        static char const* const keys[] = {"id", "name", "tags", "value", "events", "a b", "q\"x", ""};
+        static char const text[] = "the quick brown fox jumps over the lazy dog, again and again.";
+
+        auto const kind = depth == 0 ? 11 + pick(4) : pick(depth < 4 ? 15 : 11);
+        switch (kind)
+        {
+        case 0: put_nil(out); break;
+        case 1: put_bool(out, pick(2) != 0); break;
+        case 2: put_uint(out, pick(200)); break;
+        case 3: put_uint(out, random() >> pick(64)); break;
+        case 4: put_int(out, -static_cast<std::int64_t>(random() >> (1 + pick(63)))); break;
+        case 5: put_float32(out, static_cast<float>(pick(1000)) / 8); break;
+        case 6: put_float64(out, static_cast<double>(random() % 100000) / 3); break;
+        case 7: put_str(out, text, pick(sizeof text - 1)); break;
+        case 8: put_str(out, std::string(300 + pick(300), 'x')); break;
+        case 9: put_bin(out, text, pick(40)); break;
+        case 10: put_ext(out, static_cast<std::int8_t>(pick(256)), text, 1u << pick(5)); break;
+        case 11:
+        case 12:
+          {
+            auto const count = pick(6);
+            put_map(out, count);
+            for (std::uint64_t i = 0; i != count; ++i)
+            {
+                switch (pick(12))
+                {
+                case 0: put_uint(out, pick(10)); break;
+                case 1: put_array(out, 1); put_uint(out, pick(10)); break;
+                default:
+                  {
+                    auto const key = keys[pick(sizeof keys / sizeof keys[0])];
+                    put_str(out, key, std::strlen(key));
+                  }
+                    break;
+                }
+                object(out, depth + 1);
+            }
+          }
+            break;
+        case 13:
+          {
+            auto const count = pick(8);
+            put_array(out, count);
+            for (std::uint64_t i = 0; i != count; ++i)
+            {
+                object(out, depth + 1);
+            }
+          }
+            break;
+        default:
+          {
+            put_map(out, 1);
+            put_str(out, "wide", 4);
+            auto const count = 1 + pick(4);
+            put_map(out, count);
+            for (std::uint64_t i = 0; i != count; ++i)
+            {
+                put_str(out, "k" + std::to_string(pick(3000)));
+                put_uint(out, pick(100));
+            }
+          }
+            break;
+        }
+    }
+
+    std::uint64_t pick(std::uint64_t n) { return random() % n; }
+
+    std::mt19937_64 random;
+};
+
+} // namespace corpus
+
+#endif // MSGVIEWER_TESTS_CORPUS_HPP
@@ -0,0 +1,135 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// The descriptor table reads the same header as the branch ladder it replaced, for every type
+// byte, both unchecked and checked against the end of the input.
+
+#include <string>
+#include <cstdint>
+#include <cstdio>
+
+#include "msgscan/format.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+using msgscan::Header;
+using msgscan::loadbe16;
+using msgscan::loadbe32;
+
+// The if/else ladder and switch from bench/dispatch.cpp.
+Header ladder_read_header(char const* p)
+{
+    auto const byte = static_cast<unsigned char>(*p);
+
+    if (byte <= 0x7fu)
+    {
+        return {1, 0, 0};
+    }
+    else if (byte <= 0x8fu)
+    {
+        return {1, 0, (byte - 0x80u) * 2u};
+    }
+    else if (byte <= 0x9fu)
+    {
+        return {1, 0, byte - 0x90u};
+    }
+    else if (byte <= 0xbfu)
+    {
+        return {1, byte - 0xa0u, 0};
+    }
+    else if (byte <= 0xdfu)
+    {
+        switch (byte)
+        {
+        case 0xc0u: case 0xc1u: case 0xc2u: case 0xc3u: return {1, 0, 0};
+        case 0xc4u: return {2, *reinterpret_cast<std::uint8_t const*>(p + 1), 0};
+        case 0xc5u: return {3, loadbe16(p + 1), 0};
+        case 0xc6u: return {5, loadbe32(p + 1), 0};
+        case 0xc7u: return {3, *reinterpret_cast<std::uint8_t const*>(p + 1), 0};
+        case 0xc8u: return {4, loadbe16(p + 1), 0};
+        case 0xc9u: return {6, loadbe32(p + 1), 0};
+        case 0xcau: return {1, 4, 0};
+        case 0xcbu: return {1, 8, 0};
+        case 0xccu: return {1, 1, 0};
+        case 0xcdu: return {1, 2, 0};
+        case 0xceu: return {1, 4, 0};
+        case 0xcfu: return {1, 8, 0};
+        case 0xd0u: return {1, 1, 0};
+        case 0xd1u: return {1, 2, 0};
+        case 0xd2u: return {1, 4, 0};
+        case 0xd3u: return {1, 8, 0};
+        case 0xd4u: return {2, 1, 0};
+        case 0xd5u: return {2, 2, 0};
+        case 0xd6u: return {2, 4, 0};
+        case 0xd7u: return {2, 8, 0};
+        case 0xd8u: return {2, 16, 0};
+        case 0xd9u: return {2, *reinterpret_cast<std::uint8_t const*>(p + 1), 0};
+        case 0xdau: return {3, loadbe16(p + 1), 0};
+        case 0xdbu: return {5, loadbe32(p + 1), 0};
+        case 0xdcu: return {3, 0, loadbe16(p + 1)};
+        case 0xddu: return {5, 0, loadbe32(p + 1)};
+        case 0xdeu: return {3, 0, loadbe16(p + 1) * std::uint64_t{2}};
+        default:    return {5, 0, loadbe32(p + 1) * std::uint64_t{2}};
+        }
+    }
+    else /*if (byte <= 0xffu)*/
+    {
+        return {1, 0, 0};
+    }
+}
+
+bool same(Header const& a, Header const& b)
+{
+    return a.size == b.size && a.payload == b.payload && a.count == b.count;
+}
+
+void compare(unsigned byte, std::string const& lengths)
+{
+    char what[64];
+    std::snprintf(what, sizeof what, "type byte 0x%02x, length bytes 0x%02x...", byte, static_cast<unsigned char>(lengths[0]));
+
+    std::string data(1, static_cast<char>(byte));
+    data += lengths;
+    auto const expected = ladder_read_header(data.data());
+
+    check(same(msgscan::read_header(data.data()), expected), "unchecked", what);
+
+    // With the input ending anywhere from right after the type byte to past the margin.
+    for (std::size_t length = 1; length <= data.size(); ++length)
+    {
+        auto const p = data.data();
+        Header h{};
+        auto const read = msgscan::read_header(p, p + length, h);
+        check(read == (length >= expected.size), "checked cuts where the header does", what);
+        check(!read || same(h, expected), "checked", what);
+    }
+
+    Header h{};
+    check(!msgscan::read_header(data.data(), data.data(), h), "checked at the end", what);
+}
+
+} // namespace
+
+
+int main()
+{
+    // Length bytes of small, mid-range and all-ones values, past the widest header and the
+    // unchecked margin.
+    for (unsigned byte = 0; byte != 256; ++byte)
+    {
+        for (char const fill : {'\x00', '\x01', '\x7f', '\x80', '\xff'})
+        {
+            compare(byte, std::string(32, fill));
+        }
+        compare(byte, std::string("\x12\x34\x56\x78\x9a\xbc\xde\xf0", 8) + std::string(24, '\0'));
+    }
+
+    return corpus::failures() != 0;
+}
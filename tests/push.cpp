@@ -0,0 +1,130 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Parsing a stream chunk by chunk with push() reports the same events as scan() over the whole
+// of it, however it is cut: at random, byte by byte, with containers declined, and when it
+// ends in the middle of an object.
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <cstdint>
+
+#include "msgscan/push.hpp"
+#include "msgscan/visitor.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+using msgscan::Token;
+
+// Writes every event down, with the contents of strs, bins and exts, to be compared whole.
+// Declines every `decline`-th container if non-zero.
+struct EventLog final : msgscan::BasicVisitor
+{
+    explicit EventLog(unsigned decline) : decline{decline} { }
+
+    void on_nil(Token t) { event("nil", t); }
+    void on_never_used(Token t) { event("never used", t); }
+    void on_bool(Token t, bool value) { event(value ? "true" : "false", t); }
+    void on_uint(Token t, std::uint64_t value) { event("uint", t); log += std::to_string(value); }
+    void on_int(Token t, std::int64_t value) { event("int", t); log += std::to_string(value); }
+    void on_float(Token t, double value) { event("float", t); log += std::to_string(value); }
+    void on_str(Token t, char const* data, std::uint32_t length) { event("str", t); log.append(data, length); }
+    void on_bin(Token t, char const* data, std::uint32_t length) { event("bin", t); log.append(data, length); }
+    void on_ext(Token t, std::int8_t type, char const* data, std::uint32_t length) { event("ext", t); log += std::to_string(type); log.append(data, length); }
+    void end_array(Token t) { event("end array", t); }
+    void end_map(Token t) { event("end map", t); }
+    void on_truncated(Token t) { event("truncated", t); }
+
+    bool begin_array(Token t, std::uint32_t count) { return begin("array", t, count); }
+    bool begin_map(Token t, std::uint32_t count) { return begin("map", t, count); }
+
+    std::string log;
+
+private:
+    void event(char const* name, Token t)
+    {
+        log += '\n';
+        log += name;
+        log += ' ';
+        log += std::to_string(t.offset);
+        log += ' ';
+        log += std::to_string(t.type);
+        log += ' ';
+    }
+
+    bool begin(char const* name, Token t, std::uint32_t count)
+    {
+        event(name, t);
+        log += std::to_string(count);
+        return !decline || ++containers % decline != 0;
+    }
+
+    unsigned const decline;
+    unsigned containers = 0;
+};
+
+std::string scanned(std::string const& data, unsigned decline)
+{
+    EventLog log{decline};
+    msgscan::scan(data.data(), data.data() + data.size(), log);
+    return log.log;
+}
+
+// Pushes `data` in chunks of sizes drawn by `next_size`.
+template <class NextSize>
+std::string pushed(std::string const& data, unsigned decline, NextSize next_size)
+{
+    EventLog log{decline};
+    msgscan::PushState state;
+    for (std::size_t at = 0; at != data.size(); )
+    {
+        auto const size = std::min(next_size(), data.size() - at);
+        msgscan::push(state, data.data() + at, data.data() + at + size, log);
+        at += size;
+    }
+    msgscan::finish(state, log);
+    return log.log;
+}
+
+void compare(std::string const& name, std::string const& data)
+{
+    std::mt19937_64 random{5};
+    for (unsigned decline : {0u, 2u, 3u})
+    {
+        auto const what = name + ", declining every " + std::to_string(decline) + "th container";
+        auto const expected = scanned(data, decline);
+
+        check(pushed(data, decline, [] { return std::size_t{1}; }) == expected, "byte by byte", what.c_str());
+        check(pushed(data, decline, [&] { return std::size_t{1} + random() % 7; }) == expected, "in small chunks", what.c_str());
+        for (int i = 0; i != 10; ++i)
+        {
+            auto const largest = std::size_t{1} << (random() % 16);
+            check(pushed(data, decline, [&] { return std::size_t{1} + random() % largest; }) == expected, "in random chunks", what.c_str());
+        }
+    }
+}
+
+} // namespace
+
+
+int main()
+{
+    auto const data = corpus::Generator{6}.records(std::size_t{64} << 10);
+    compare("records", data);
+
+    // Ending in the middle of a header, of a payload, and of a container.
+    for (std::size_t cut : {1u, 2u, 5u, 17u, 301u})
+    {
+        compare("records cut " + std::to_string(cut) + " bytes short", data.substr(0, data.size() - cut));
+    }
+
+    return corpus::failures() != 0;
+}
@@ -0,0 +1,176 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Path queries: what parses and what does not, how literals are read, what a query selects
+// from a few known records, and that find_paths names each selected object by a path that
+// selects it again.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+#include "msgscan/records.hpp"
+#include "msgscan/search.hpp"
+#include "msgscan/query.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+
+std::vector<std::uint64_t> select(std::string const& data, std::string const& text)
+{
+    std::vector<std::uint64_t> hits;
+    msgscan::PathQuery query;
+    auto const error = msgscan::parse(text, query);
+    check(!error, "parses", text.c_str());
+    if (!error) { msgscan::find_matches(data.data(), data.data() + data.size(), 0, query, hits); }
+    return hits;
+}
+
+void parsing()
+{
+    for (auto const text : {".", ".id", ".a.b", ".*", "[0]", "[*]", "[\"a b\"]", "[\"q\\\"x\"]", ".events[*].latency_ms",
+                            ".x where .y == 1", ".x where .y != -1.5", ".x where .y < \"s\"", ".x where .y <= true",
+                            ".x where .y > false", ".x where .y >= nil", ".x where .y == null", "  .x  where  .y==1  "})
+    {
+        msgscan::PathQuery query;
+        check(!msgscan::parse(text, query), "parses", text);
+    }
+
+    for (auto const text : {"", "id", "..", ".id.", "[", "[x]", "[*", "[\"a", ".a b", ".x where", ".x where .y",
+                            ".x where .y ==", ".x where .y ~ 1", ".x where .y == what", ".x where .y == 1 more"})
+    {
+        msgscan::PathQuery query;
+        check(msgscan::parse(text, query) != nullptr, "does not parse", text);
+    }
+
+    msgscan::PathQuery query;
+    msgscan::parse(".x where .y == 18446744073709551615", query);
+    check(query.value.integral && !query.value.negative && query.value.natural == ~std::uint64_t{0}, "largest uint64 is exact");
+
+    msgscan::parse(".x where .y == -9223372036854775808", query);
+    check(query.value.integral && query.value.negative && query.value.integer == INT64_MIN, "smallest int64 is exact");
+
+    msgscan::parse(".x where .y == 18446744073709551616", query);
+    check(!query.value.integral && query.value.kind == msgscan::Literal::Kind::number, "beyond uint64 is a float");
+
+    msgscan::parse(".x where .y == -0", query);
+    check(query.value.integral && !query.value.negative, "minus zero is zero");
+}
+
+void selecting()
+{
+    using namespace corpus;
+
+    // {"id": UINT64_MAX, "name": "x", "tags": [1, 2, 3]}
+    std::string data;
+    put_map(data, 3);
+    put_str(data, "id");
+    auto const id0 = data.size();
+    put_uint(data, ~std::uint64_t{0});
+    put_str(data, "name");
+    auto const name0 = data.size();
+    put_str(data, "x");
+    put_str(data, "tags");
+    put_array(data, 3);
+    auto const tags0 = data.size();
+    put_uint(data, 1);
+    put_uint(data, 2);
+    put_uint(data, 3);
+
+    // {"id": -3, "name": "y", "tags": []}
+    put_map(data, 3);
+    put_str(data, "id");
+    auto const id1 = data.size();
+    put_int(data, -3);
+    put_str(data, "name");
+    auto const name1 = data.size();
+    put_str(data, "y");
+    put_str(data, "tags");
+    put_array(data, 0);
+
+    // {"id": 5, "a b": {"c": true}, 7: nil}
+    put_map(data, 3);
+    put_str(data, "id");
+    put_uint(data, 5);
+    put_str(data, "a b");
+    put_map(data, 1);
+    put_str(data, "c");
+    auto const c2 = data.size();
+    put_bool(data, true);
+    put_uint(data, 7);
+    auto const nil2 = data.size();
+    put_nil(data);
+
+    using Hits = std::vector<std::uint64_t>;
+    check(select(data, ".") == Hits{0, id1 - 4, c2 - 12}, ".");
+    check(select(data, ".name") == Hits{name0, name1}, ".name");
+    check(select(data, ".tags[*]") == Hits{tags0, tags0 + 1, tags0 + 2}, ".tags[*]");
+    check(select(data, ".tags[1]") == Hits{tags0 + 1}, ".tags[1]");
+    check(select(data, "[\"a b\"].c") == Hits{c2}, "[\"a b\"].c");
+    check(select(data, "[7]") == Hits{nil2}, "[7]");
+    check(select(data, ".name where .id == 18446744073709551615") == Hits{name0}, "integer beyond int64");
+    check(select(data, ".name where .id == 18446744073709551614").empty(), "integer beyond int64, off by one");
+    check(select(data, ".id where .id > 9223372036854775807") == Hits{id0}, "uint64 above int64");
+    check(select(data, ".id where .id < 0") == Hits{id1}, "negative");
+    check(select(data, ".name where .tags[*] == 2") == Hits{name0}, "filter on elements");
+    check(select(data, ".id where .name == \"y\"") == Hits{id1}, "filter on strs");
+    check(select(data, ".id where .nothing == 1").empty(), "filter on nothing");
+}
+
+// Each object selected by `text` in `data` has a path that selects it alone among those of its
+// record, or with the others a wildcard would.
+void naming(std::string const& data, std::string const& text)
+{
+    std::vector<std::uint64_t> records;
+    auto truncated = false;
+    msgscan::find_records(data.data(), data.data() + data.size(), records, truncated, [](std::uint64_t) { return true; });
+
+    auto const hits = select(data, text);
+    std::vector<std::pair<std::uint64_t, std::string>> named;
+    for (auto hit = hits.begin(); hit != hits.end(); )
+    {
+        auto const record = std::upper_bound(records.begin(), records.end(), *hit);
+        auto const begin = record[-1];
+        auto const end = record != records.end() ? *record : data.size();
+        auto const next = std::lower_bound(hit, hits.end(), end);
+        msgscan::find_paths(data.data() + begin, data.data() + end, begin, &*hit, &*hit + (next - hit), [&](std::uint64_t offset, std::string const& path)
+        {
+            named.emplace_back(offset, path);
+        });
+        hit = next;
+    }
+    check(named.size() == hits.size(), "every match named", text.c_str());
+
+    for (auto const& n : named)
+    {
+        check(n.second.find("[*]") == std::string::npos, "concrete path", n.second.c_str());
+        auto const again = select(data, n.second);
+        check(std::binary_search(again.begin(), again.end(), n.first), "path selects the match again", n.second.c_str());
+    }
+}
+
+} // namespace
+
+
+int main()
+{
+    parsing();
+    selecting();
+
+    auto const data = corpus::Generator{7}.records(std::size_t{16} << 10);
+    naming(data, ".");
+    naming(data, "[*]");
+    naming(data, "[*][*]");
+    naming(data, "[*][*][*]");
+
+    return corpus::failures() != 0;
+}
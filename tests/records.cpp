@@ -0,0 +1,84 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// The parallel record indexer finds the same records as the single-threaded one, reports
+// progress that never goes back, and can be cancelled.
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "msgscan/records.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+
+void compare(std::string const& name, std::string const& data)
+{
+    auto const begin = data.data();
+    auto const end = begin + data.size();
+
+    std::vector<std::uint64_t> expected;
+    auto expected_truncated = false;
+    msgscan::find_records(begin, end, expected, expected_truncated, [](std::uint64_t) { return true; });
+
+    for (unsigned workers : {2u, 3u, 4u})
+    {
+        auto const what = name + " with " + std::to_string(workers) + " workers";
+
+        std::vector<std::uint64_t> records;
+        auto truncated = false;
+        std::uint64_t last = 0;
+        auto monotonic = true;
+        auto const done = msgscan::find_records(begin, end, records, truncated, workers, [&](std::uint64_t consumed)
+        {
+            monotonic = monotonic && last <= consumed && consumed <= data.size();
+            last = consumed;
+            return true;
+        });
+
+        check(done, "completes", what.c_str());
+        check(records == expected, "same records", what.c_str());
+        check(truncated == expected_truncated, "same truncation", what.c_str());
+        check(monotonic, "progress within the input and never back", what.c_str());
+
+        records.clear();
+        auto const cancelled = !msgscan::find_records(begin, end, records, truncated, workers, [](std::uint64_t) { return false; });
+        check(cancelled, "cancels", what.c_str());
+    }
+}
+
+} // namespace
+
+
+int main()
+{
+    // Three chunks of the parallel indexer's minimum size.
+    auto const size = std::size_t{50} << 20;
+    auto const data = corpus::Generator{1}.records(size);
+    compare("records", data);
+
+    // Cut in the middle of the last record.
+    compare("truncated records", data.substr(0, data.size() - 3));
+
+    // Records between bins of random bytes, where the workers' guesses go wrong.
+    std::string noisy;
+    corpus::Generator noise{2};
+    while (noisy.size() < size)
+    {
+        std::string bytes(noise.pick(1 << 16), '\0');
+        for (auto& c : bytes) { c = static_cast<char>(noise.random()); }
+        corpus::put_bin(noisy, bytes.data(), bytes.size());
+        noise.object(noisy, 0);
+    }
+    compare("noise", noisy);
+
+    return corpus::failures() != 0;
+}
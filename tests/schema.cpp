@@ -0,0 +1,90 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Inferring a schema on several threads gives the same paths and shapes as on one, wide maps
+// included, and the bytes counted at the paths add up to the input.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "msgscan/records.hpp"
+#include "msgscan/schema.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+using Report = std::vector<std::pair<std::string, msgscan::Shape>>;
+
+bool same(msgscan::Shape const& a, msgscan::Shape const& b)
+{
+    return a.count == b.count
+        && std::equal(a.kinds, a.kinds + msgscan::Shape::kind_count, b.kinds)
+        && a.min_length == b.min_length && a.max_length == b.max_length
+        && (a.min_value == b.min_value || (!a.has_value() && !b.has_value()))
+        && (a.max_value == b.max_value || (!a.has_value() && !b.has_value()))
+        && std::equal(a.bytes, a.bytes + msgscan::Shape::kind_count, b.bytes)
+        && std::equal(a.header_bytes, a.header_bytes + msgscan::Shape::kind_count, b.header_bytes)
+        && a.keys == b.keys && a.key_bytes == b.key_bytes && a.key_header_bytes == b.key_header_bytes;
+}
+
+Report infer(std::string const& data, std::vector<std::uint64_t> const& records, unsigned workers)
+{
+    msgscan::Schema schema;
+    auto const done = msgscan::infer_schema(data.data(), data.data() + data.size(), records.data(), records.size(), workers, schema, [](std::uint64_t) { return true; });
+    check(done, "completes");
+    return schema.report();
+}
+
+} // namespace
+
+
+int main()
+{
+    // Several blocks of the pass's size.
+    auto const data = corpus::Generator{4}.records(std::size_t{12} << 20);
+
+    std::vector<std::uint64_t> records;
+    auto truncated = false;
+    msgscan::find_records(data.data(), data.data() + data.size(), records, truncated, [](std::uint64_t) { return true; });
+
+    auto const expected = infer(data, records, 1);
+
+    // Records of the corpus have more distinct keys under "wide" than are kept apart.
+    auto const folded = std::any_of(expected.begin(), expected.end(), [](Report::value_type const& r) { return r.first == ".wide.*"; });
+    auto const unfolded = std::any_of(expected.begin(), expected.end(), [](Report::value_type const& r) { return r.first.compare(0, 7, ".wide.k") == 0; });
+    check(folded && !unfolded, "wide maps folded");
+
+    std::uint64_t total = 0;
+    for (auto const& r : expected) { total += r.second.total_bytes(); }
+    check(total == data.size(), "bytes add up to the input");
+
+    for (unsigned workers : {2u, 3u, 5u})
+    {
+        auto const what = std::to_string(workers) + " workers";
+        auto const report = infer(data, records, workers);
+
+        auto equal = report.size() == expected.size();
+        for (std::size_t i = 0; equal && i != report.size(); ++i)
+        {
+            equal = report[i].first == expected[i].first && same(report[i].second, expected[i].second);
+        }
+        check(equal, "same schema", what.c_str());
+    }
+
+    // Cancelled at the first block.
+    msgscan::Schema schema;
+    auto const cancelled = !msgscan::infer_schema(data.data(), data.data() + data.size(), records.data(), records.size(), 2, schema, [](std::uint64_t) { return false; });
+    check(cancelled, "cancels");
+
+    return corpus::failures() != 0;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Searching on several threads finds the same matches, in file order, as scanning the whole
+// input at once, for text, numbers and path queries.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "msgscan/records.hpp"
+#include "msgscan/search.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+
+template <class Q>
+void compare(std::string const& name, std::string const& data, std::vector<std::uint64_t> const& records, Q const& query)
+{
+    auto const begin = data.data();
+    auto const end = begin + data.size();
+
+    std::vector<std::uint64_t> expected;
+    msgscan::find_matches(begin, end, 0, query, expected);
+    check(!expected.empty(), "matches something", name.c_str());
+
+    for (unsigned workers : {1u, 2u, 5u})
+    {
+        auto const what = name + " with " + std::to_string(workers) + " workers";
+
+        std::vector<std::uint64_t> hits;
+        std::uint64_t last = 0;
+        auto monotonic = true;
+        auto const done = msgscan::search(begin, end, records.data(), records.size(), query, workers, [&](std::vector<std::uint64_t> const& batch, std::uint64_t consumed)
+        {
+            hits.insert(hits.end(), batch.begin(), batch.end());
+            monotonic = monotonic && last <= consumed && consumed <= data.size();
+            last = consumed;
+            return true;
+        });
+
+        check(done, "completes", what.c_str());
+        check(hits == expected, "same matches in file order", what.c_str());
+        check(monotonic && last == data.size(), "progress up to the whole input", what.c_str());
+
+        auto const cancelled = !msgscan::search(begin, end, records.data(), records.size(), query, workers, [](std::vector<std::uint64_t> const&, std::uint64_t) { return false; });
+        check(cancelled, "cancels", what.c_str());
+    }
+}
+
+void compare_path(std::string const& text, std::string const& data, std::vector<std::uint64_t> const& records)
+{
+    msgscan::PathQuery query;
+    auto const error = msgscan::parse(text, query);
+    check(!error, "parses", text.c_str());
+    if (!error) { compare(text, data, records, query); }
+}
+
+} // namespace
+
+
+int main()
+{
+    // Several blocks of the search's size.
+    auto const data = corpus::Generator{3}.records(std::size_t{12} << 20);
+
+    std::vector<std::uint64_t> records;
+    auto truncated = false;
+    msgscan::find_records(data.data(), data.data() + data.size(), records, truncated, [](std::uint64_t) { return true; });
+
+    msgscan::Query text;
+    text.text = "fox";
+    compare("text", data, records, text);
+
+    msgscan::Query number;
+    number.text = "7";
+    number.match_number = true;
+    number.number = 7;
+    compare("number", data, records, number);
+
+    compare_path(".", data, records);
+    compare_path(".name", data, records);
+    compare_path("[*]", data, records);
+    compare_path("[*][*].wide.*", data, records);
+    compare_path("[\"a b\"]", data, records);
+    compare_path(".tags where .id < 100", data, records);
+    compare_path(".events[*] where .value == nil", data, records);
+
+    return corpus::failures() != 0;
+}
@@ -0,0 +1,219 @@
+// Copyright (c) 2017 Kohei Takahashi
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// The SSE2 and AVX2 text kernels agree with the scalar ones: searches for needles of every
+// length, and validation of UTF-8 with malformed sequences placed across block edges and at
+// the end of the input.
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "msgscan/text.hpp"
+
+#include "corpus.hpp"
+
+
+namespace
+{
+
+using corpus::check;
+
+std::mt19937_64 random{9};
+
+std::uint64_t pick(std::uint64_t n) { return random() % n; }
+
+// Well-formed sequences of one to four bytes, the boundaries of each length included.
+char const* const valid[] =
+{
+    "a", "\x7f", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xe1\x80\x80", "\xed\x9f\xbf", "\xee\x80\x80",
+    "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf3\xbf\xbf\xbf", "\xf4\x8f\xbf\xbf",
+};
+
+// Malformed on their own: overlong forms, surrogates, code points above U+10FFFF, bytes that
+// never appear, stray continuations, and leads cut short.
+char const* const invalid[] =
+{
+    "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xe0\x9f\xbf", "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf",
+    "\xed\xa0\x80", "\xed\xbf\xbf",
+    "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xf7\xbf\xbf\xbf",
+    "\xf8", "\xfe", "\xff",
+    "\x80", "\xbf", "\xc2\x80\x80",
+    "\xc2", "\xe1\x80", "\xf1\x80\x80", "\xc2" "a", "\xe1\x80" "a", "\xf1\x80\x80" "a",
+};
+
+// Random well-formed text, mostly ASCII, of at least `length` bytes.
+std::string text(std::size_t length)
+{
+    std::string out;
+    while (out.size() < length)
+    {
+        out += pick(3) ? std::string(1, static_cast<char>(' ' + pick(95))) : valid[pick(sizeof valid / sizeof valid[0])];
+    }
+    return out;
+}
+
+// Whether each kernel gives the scalar answer on `data`.
+void validate(std::string const& data, char const* what)
+{
+    auto const expected = msgscan::detail::valid_utf8_scalar(data.data(), data.size());
+
+#if MSGSCAN_SSE2
+    check(msgscan::detail::valid_utf8_sse2(data.data(), data.size()) == expected, "sse2 validates like scalar", what);
+#endif
+#if MSGSCAN_AVX2
+    if (msgscan::detail::has_avx2())
+    {
+        check(msgscan::detail::valid_utf8_avx2(data.data(), data.size()) == expected, "avx2 validates like scalar", what);
+    }
+#endif
+    check(msgscan::valid_utf8(data.data(), data.size()) == expected, "valid_utf8 validates like scalar", what);
+}
+
+void validating()
+{
+    // Known answers for the scalar kernel itself.
+    for (auto const s : valid)
+    {
+        check(msgscan::detail::valid_utf8_scalar(s, std::strlen(s)), "valid sequence", s);
+    }
+    for (auto const s : invalid)
+    {
+        check(!msgscan::detail::valid_utf8_scalar(s, std::strlen(s)), "invalid sequence", s);
+    }
+
+    // Each sequence at every offset around the 16- and 32-byte edges, and at the end, of
+    // inputs of every length up to a few blocks.
+    for (std::size_t length = 0; length <= 100; ++length)
+    {
+        auto const base = text(length).substr(0, length);
+        auto const clean = std::string(length, 'a');
+        validate(base, "random text");
+
+        for (auto const list : {valid, invalid})
+        {
+            auto const count = list == valid ? sizeof valid / sizeof valid[0] : sizeof invalid / sizeof invalid[0];
+            for (std::size_t i = 0; i != count; ++i)
+            {
+                std::string const s = list[i];
+                for (std::size_t at = 0; at + s.size() <= length; ++at)
+                {
+                    char what[96];
+                    std::snprintf(what, sizeof what, "sequence %zu of the %s at %zu of %zu", i, list == valid ? "valid" : "invalid", at, length);
+
+                    // In ASCII, and in random text where it may cut a sequence apart.
+                    for (auto data : {clean, base})
+                    {
+                        data.replace(at, s.size(), s);
+                        validate(data, what);
+                    }
+                }
+            }
+        }
+    }
+
+    // Long random inputs with a few bytes spoiled, anywhere.
+    for (int i = 0; i != 2000; ++i)
+    {
+        auto data = text(pick(600));
+        for (auto n = pick(3); n--; )
+        {
+            if (data.empty()) { break; }
+            auto const s = std::string(invalid[pick(sizeof invalid / sizeof invalid[0])]);
+            auto const at = pick(data.size());
+            data.replace(at, std::min(s.size(), data.size() - at), s);
+        }
+        validate(data, "random text, spoiled");
+    }
+}
+
+// Whether each kernel gives the scalar answer for `needle` in `data`.
+void search(std::string const& data, std::string const& needle, char const* what)
+{
+    auto const begin = data.data();
+    auto const found = std::search(data.begin(), data.end(), needle.begin(), needle.end());
+    auto const expected = found != data.end() ? begin + (found - data.begin()) : nullptr;
+    auto const n = needle.size();
+
+    check(msgscan::find(begin, data.size(), needle.data(), n) == (n == 0 ? begin : expected), "find", what);
+
+    // The kernels take needles of two bytes or more that fit in the input.
+    if (n < 2 || n > data.size()) { return; }
+
+    check(msgscan::detail::find_scalar(begin, data.size(), needle.data(), n) == expected, "scalar", what);
+#if MSGSCAN_SSE2
+    check(msgscan::detail::find_sse2(begin, data.size(), needle.data(), n) == expected, "sse2 finds like scalar", what);
+#endif
+#if MSGSCAN_AVX2
+    if (msgscan::detail::has_avx2())
+    {
+        check(msgscan::detail::find_avx2(begin, data.size(), needle.data(), n) == expected, "avx2 finds like scalar", what);
+    }
+#endif
+}
+
+void searching()
+{
+    // Over a small alphabet, so that first and last bytes match often.
+    auto const noise = [](std::size_t length)
+    {
+        std::string out(length, 'a');
+        for (auto& c : out) { c = static_cast<char>('a' + pick(3)); }
+        return out;
+    };
+
+    for (std::size_t length = 0; length <= 100; ++length)
+    {
+        auto const data = noise(length);
+        for (std::size_t n : {0u, 1u, 2u, 3u, 15u, 16u, 17u, 31u, 32u, 33u, 40u})
+        {
+            char what[64];
+            std::snprintf(what, sizeof what, "%zu in %zu bytes", n, length);
+
+            search(data, noise(n), what);
+
+            // Planted so that it ends at the end, and so that it straddles each block edge.
+            if (n <= length)
+            {
+                search(data, data.substr(length - n), what);
+                for (std::size_t edge = 16; edge < length; edge += 16)
+                {
+                    for (std::size_t at = edge >= n ? edge - n + 1 : 0; at < edge && at + n <= length; ++at)
+                    {
+                        auto const needle = noise(n);
+                        auto planted = data;
+                        planted.replace(at, n, needle);
+                        search(planted, needle, what);
+                    }
+                }
+            }
+        }
+    }
+
+    // Longer needles, found and missed by their last byte.
+    for (int i = 0; i != 500; ++i)
+    {
+        auto const data = noise(1 + pick(1000));
+        auto const at = pick(data.size());
+        auto needle = data.substr(at, 2 + pick(80));
+        search(data, needle, "taken from the input");
+        needle.back() = 'z';
+        search(data, needle, "last byte missing");
+    }
+}
+
+} // namespace
+
+
+int main()
+{
+    validating();
+    searching();
+
+    return corpus::failures() != 0;
+}